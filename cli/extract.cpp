@@ -25,7 +25,11 @@ THE SOFTWARE.*/
 #include "path.h"
 
 #include <ZAP/Archive.h>
+#include <ZAP/EntryStream.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -44,11 +48,17 @@ namespace cli
 		ZAP::Archive::EntryList filelist;
 		archive.getFileList(filelist);
 
+		// Tables with a perfect hash are in the order of its slots, list by path instead
+		std::sort(filelist.begin(), filelist.end(), [](const ZAP::Archive::Entry *lhs, const ZAP::Archive::Entry *rhs)
+		{
+			return (std::strcmp(lhs->virtual_path, rhs->virtual_path) < 0);
+		});
+
 		static const int fieldMargin = 1;
 		int field0 = 4+fieldMargin, field1 = 10+fieldMargin, field2 = 12+fieldMargin;
 		for (const ZAP::Archive::Entry *entry : filelist)
 		{
-			int newField0 = static_cast<int>(entry->virtual_path.size())+fieldMargin;
+			int newField0 = static_cast<int>(entry->virtual_path_size)+fieldMargin;
 			int newField1 = static_cast<int>(getPrettySize(entry->compressed_size).size())+fieldMargin;
 			int newField2 = static_cast<int>(getPrettySize(entry->decompressed_size).size())+fieldMargin;
 			if (newField0 > field0)
@@ -59,7 +69,7 @@ namespace cli
 				field2 = newField2;
 		}
 
-		int totalComp = 0, totalDecomp = 0;
+		std::uint64_t totalComp = 0, totalDecomp = 0;
 
 		std::ios::fmtflags nameFlags = std::ios::left;
 		std::ios::fmtflags sizeFlags = std::ios::right;
@@ -147,24 +157,31 @@ namespace cli
 					continue;
 				}
 
-				char *data;
-				size_t size;
-
 				bool extractSuccess = false;
 				if (options[RAW])
-					extractSuccess = archive.getRawData(entry, data, size);
+				{
+					ZAP::Buffer data;
+					extractSuccess = archive.getRawData(entry, data);
+					if (extractSuccess)
+						stream.write(data.getData(), data.getSize());
+				}
 				else
-					extractSuccess = archive.getData(entry, data, size);
+				{
+					// Decompressed a piece at a time, so files larger than memory can be extracted
+					ZAP::EntryReader reader(archive, entry);
+					const char *chunk;
+					std::size_t count;
+					while ((count = reader.readChunk(chunk)) > 0)
+						stream.write(chunk, count);
+
+					extractSuccess = (reader.isOpen() && reader.isEnd() && !reader.hasFailed());
+				}
 
 				if (!extractSuccess)
 				{
 					std::cerr << "Could not extract entry " << entry->virtual_path << std::endl;
 					continue;
 				}
-
-				stream.write(data, size);
-
-				delete[] data;
 			}
 		}
 
@@ -21,6 +21,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.*/
 #include "extract.h"
 #include "pack.h"
+#include "pretty.h"
 
 #include <ZAP/Archive.h>
 #include <ZAP/ArchiveBuilder.h>
@@ -30,7 +31,7 @@ THE SOFTWARE.*/
 #include <iostream>
 #include <memory>
 
-option::ArgStatus checkCompress(const option::Option &option, bool msg)
+option::ArgStatus checkCompress(const option::Option &option, bool /*msg*/)
 {
 	ZAP::Compression compression = static_cast<ZAP::Compression>(std::atoi(option.arg));
 	if (!ZAP::supportsCompression(compression))
@@ -38,6 +39,14 @@ option::ArgStatus checkCompress(const option::Option &option, bool msg)
 	else
 		return option::ARG_OK;
 }
+option::ArgStatus checkFormat(const option::Option &option, bool /*msg*/)
+{
+	ZAP::Version version;
+	if (option.arg == nullptr || !cli::parsePrettyVersion(option.arg, version))
+		return option::ARG_ILLEGAL;
+	else
+		return option::ARG_OK;
+}
 
 const option::Descriptor usage[] =
 {
@@ -48,6 +57,8 @@ const option::Descriptor usage[] =
 	{ cli::COMPRESS,  0, "c", "compress",  checkCompress,         "--compress, -c  \tSet compression for pack." },
 	{ cli::RECURSIVE, 0, "r", "recursive", option::Arg::None,     "--recursive, -r  \tRecursively add files to the archive." },
 	{ cli::RAW,       0, "", "raw",        option::Arg::None,     "--raw  \tExtract raw data (compressed)." },
+	{ cli::FORMAT,    0, "f", "format",    checkFormat,           "--format, -f  \tSet format version for pack (1.0, 2.0 or 3.0, defaults to 2.0, 3.0 is needed over 4 GiB)." },
+	{ cli::PERFECT_HASH, 0, "", "perfect-hash", option::Arg::None, "--perfect-hash  \tAdd a perfect hash to the archive on pack, so it opens without building a hash table (2.0 and up)." },
 	{0,0,0,0,0,0}
 };
 
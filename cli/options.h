@@ -35,7 +35,9 @@ namespace cli
 		PACK,
 		COMPRESS,
 		RECURSIVE,
-		RAW
+		RAW,
+		FORMAT,
+		PERFECT_HASH
 	};
 }
 
@@ -21,6 +21,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.*/
 #include "pack.h"
 #include "path.h"
+#include "pretty.h"
 #include "options.h"
 
 #include <ZAP/ArchiveBuilder.h>
@@ -122,7 +123,13 @@ namespace cli
 		if (options[COMPRESS].arg != nullptr)
 			compression = static_cast<ZAP::Compression>(std::atoi(options[COMPRESS].arg));
 
-		if (!archive.buildFile(outPath, compression))
+		archive.setPerfectHash(options[PERFECT_HASH] != nullptr);
+
+		ZAP::Version version = ZAP::Version::CURRENT;
+		if (options[FORMAT].arg != nullptr)
+			parsePrettyVersion(options[FORMAT].arg, version);
+
+		if (!archive.buildFile(outPath, compression, version))
 		{
 			std::cerr << "Could not build archive" << std::endl;
 			return 1;
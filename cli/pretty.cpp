@@ -42,9 +42,23 @@ namespace cli
 		switch (version)
 		{
 		case ZAP::Version::V1_0: return "1.0";
+		case ZAP::Version::V2_0: return "2.0";
+		case ZAP::Version::V3_0: return "3.0";
 		default: return "Unknown";
 		}
 	}
+	bool parsePrettyVersion(const std::string &text, ZAP::Version &version)
+	{
+		for (int v = static_cast<int>(ZAP::Version::MIN); v <= static_cast<int>(ZAP::Version::MAX); ++v)
+		{
+			if (text == getPrettyVersion(static_cast<ZAP::Version>(v)))
+			{
+				version = static_cast<ZAP::Version>(v);
+				return true;
+			}
+		}
+		return false;
+	}
 	std::string getPrettyCompression(ZAP::Compression compression)
 	{
 		switch (compression)
@@ -54,13 +68,13 @@ namespace cli
 		default: return "Unknown";
 		}
 	}
-	std::string getPrettySize(std::uint32_t size)
+	std::string getPrettySize(std::uint64_t size)
 	{
 		static const char *suffixes[] = { " B", " KiB", " MiB", " GiB", " TiB" };
 		static const int suffixesSize = 5;
 
 		int suffIndex = 0;
-		double newSize = size;
+		double newSize = static_cast<double>(size);
 
 		while ((newSize >= 1024.0) && (suffIndex < suffixesSize - 1))
 		{
@@ -31,8 +31,9 @@ THE SOFTWARE.*/
 namespace cli
 {
 	std::string getPrettyVersion(ZAP::Version version);
+	bool parsePrettyVersion(const std::string &text, ZAP::Version &version);
 	std::string getPrettyCompression(ZAP::Compression compression);
-	std::string getPrettySize(std::uint32_t size);
+	std::string getPrettySize(std::uint64_t size);
 }
 
 #endif // pretty_h__
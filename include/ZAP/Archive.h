@@ -23,30 +23,97 @@ THE SOFTWARE.*/
 #define ZAP_Archive_h__
 
 #include <ZAP/Compression.h>
+#include <ZAP/EntryCache.h>
+#include <ZAP/Buffer.h>
+#include <ZAP/LoadGroup.h>
+#include <ZAP/MemoryResource.h>
+#include <ZAP/PathHash.h>
 #include <ZAP/Version.h>
 
 #include <cstdint>
-#include <istream>
-#include <unordered_map>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace ZAP
 {
+	class File;
+	class WorkerPool;
+	enum class Advice;
+
 	///\brief Used to load an archive.
+	///
+	/// All const member functions can be called from any number of threads at once,
+	/// as reads don't share a stream position. Opening and closing the archive must not
+	/// happen while other threads use it.
 	class Archive
 	{
 	public:
 		///\brief File in archive.
 		struct Entry
 		{
-			std::string virtual_path;        ///< Virtual path of the file.
-			std::uint32_t index;             ///< Offset in the archive file.
-			std::uint32_t decompressed_size; ///< Size of the file when decompressed in bytes.
-			std::uint32_t compressed_size;   ///< Size of the file when compressed in bytes.
+			const char *virtual_path;        ///< Virtual path of the file, zero terminated.
+			std::uint32_t virtual_path_size; ///< Length of the virtual path, without the terminator.
+			std::uint64_t index;             ///< Offset in the archive file.
+			std::uint64_t decompressed_size; ///< Size of the file when decompressed in bytes.
+			std::uint64_t compressed_size;   ///< Size of the file when compressed in bytes.
+			std::uint64_t hash;              ///< Hash of the virtual path, see hashPath().
 		};
 		typedef std::vector<const Entry*> EntryList;
 
+		///\brief Destination of one entry in a vectored read, see getRawData(ReadTargetList&).
+		struct ReadTarget
+		{
+			const Entry *entry;   ///< The entry to read.
+			char *buffer;         ///< Buffer to read to, needs to hold at least Entry::compressed_size bytes.
+			std::size_t capacity; ///< Size of the buffer in bytes.
+			bool success;         ///< Set when the entry has been read.
+		};
+		typedef std::vector<ReadTarget> ReadTargetList;
+
+		///\brief Default largest gap between two entries that are merged into one read.
+		static const std::size_t DEFAULT_MERGE_GAP = 64 * 1024;
+
+		///\brief Default number of reads of a batch that are in flight at once, see setQueueDepth().
+		static const unsigned DEFAULT_QUEUE_DEPTH = 256;
+
+		///\brief When the lookup table is built.
+		enum class IndexMode
+		{
+			IMMEDIATE, ///< While the archive is opened.
+			LAZY,      ///< On the first lookup, the open only checks the header.
+			BACKGROUND ///< On a thread started by the open, the open only checks the header.
+		};
+
+		///\brief Read-only view of data inside the archive.
+		///
+		/// The view holds a reference to the memory it points into,
+		/// so it stays valid after the archive is closed or destroyed.
+		/// The exception is openBorrowedMemory(), where the caller owns the memory.
+		struct View
+		{
+			View() : size(0) {}
+			std::shared_ptr<const char> data; ///< The first byte of the data.
+			std::size_t size;                 ///< Size of the data in bytes.
+		};
+
+		///\brief Result of an asynchronous load.
+		struct LoadResult
+		{
+			LoadResult() : entry(nullptr), size(0), success(false), cancelled(false) {}
+			const Entry *entry;           ///< The entry that was loaded.
+			Buffer data;                  ///< The data, empty if the load failed or was cancelled.
+			std::size_t size;             ///< The data size.
+			bool success;                 ///< Whether the data was loaded.
+			bool cancelled;               ///< Whether the load was cancelled before it started.
+		};
+		typedef std::function<void(LoadResult &result)> LoadCallback;
+
 		///\brief Default constructor.
 		Archive();
 
@@ -66,12 +133,41 @@ namespace ZAP
 		///\return false if the file can't be opened.
 		bool openFile(const std::string &filename);
 
+		///\brief Opens an archive by mapping the file into memory.
+		///
+		/// Reads are served straight from the mapping, and getView() can be used
+		/// to access entries without copying them.
+		///\param filename Filename of the archive.
+		///\return false if the file can't be opened or mapped.
+		bool openMappedFile(const std::string &filename);
+
 		///\brief Opens an archive from memory.
+		///
+		/// The data is copied, so it can be freed as soon as this returns.
 		///\param data A pointer to the data.
 		///\param size Size of the data.
 		///\return false if it fails.
 		bool openMemory(const char *data, std::size_t size);
 
+		///\brief Opens an archive from memory, without copying it.
+		///
+		/// The archive reads the data in place, and getView() can be used to access entries without copying them.
+		///\note The data must stay valid until the archive is closed, and until all views into it are destroyed.
+		///\param data A pointer to the data.
+		///\param size Size of the data.
+		///\return false if it fails.
+		bool openBorrowedMemory(const char *data, std::size_t size);
+
+		///\brief Sets when the lookup table is built, used by the next open.
+		///
+		/// With LAZY and BACKGROUND, functions that need the lookup table (getEntry(), hasFile(),
+		/// getFileCount(), getFileList() and the path overloads) block until it has been built.
+		///\param mode The index mode, IMMEDIATE by default.
+		void setIndexMode(IndexMode mode);
+
+		///\brief Returns when the lookup table is built.
+		IndexMode getIndexMode() const;
+
 		///\brief Closes the archive.
 		///
 		/// It's not important to call this because it's called by the destructor.
@@ -93,38 +189,276 @@ namespace ZAP
 		///\param virtual_path Full pathname of the virtual file.
 		bool hasFile(const std::string &virtual_path) const;
 
+		///\brief Checks if the archive contains a file, without allocating.
+		///\param virtual_path Full pathname of the virtual file, does not need to be zero terminated.
+		///\param virtual_path_size Length of the pathname.
+		bool hasFile(const char *virtual_path, std::size_t virtual_path_size) const;
+
 		///\brief Extracts the data of a file.
 		///\param virtual_path Full pathname of the virtual file.
-		///\param [out] data The data, untouched if failed.
+		///\param [out] data The data, untouched if failed. Allocated from resource, size bytes.
 		///\param [out] size The data size, untouched if failed.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
 		///\return false if the virtual_path does not exist, or uses an unsupported compression.
-		bool getData(const std::string &virtual_path, char *&data, std::size_t &size) const;
-		bool getData(const Entry *entry, char *&data, std::size_t &size) const;
+		bool getData(const std::string &virtual_path, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+		bool getData(const Entry *entry, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+		bool getData(const char *virtual_path, std::size_t virtual_path_size, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+
+		///\brief Extracts the data of a file into an owning buffer.
+		///
+		/// With a BufferPool as resource, buffers that are released go back to the pool to be reused by later loads.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param [out] buffer The data, untouched if failed.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
+		///\return false if the virtual_path does not exist, or uses an unsupported compression.
+		bool getData(const std::string &virtual_path, Buffer &buffer, MemoryResource *resource = nullptr) const;
+		bool getData(const Entry *entry, Buffer &buffer, MemoryResource *resource = nullptr) const;
+		bool getData(const char *virtual_path, std::size_t virtual_path_size, Buffer &buffer, MemoryResource *resource = nullptr) const;
+
+		///\brief Extracts the data of a file into a buffer provided by the caller.
+		///
+		/// The data is read and decompressed straight into the buffer, without allocating a buffer of its own.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param [out] buffer Buffer to write the data to, needs to hold at least Entry::decompressed_size bytes.
+		///\param capacity Size of the buffer in bytes.
+		///\param [out] size The data size, untouched if failed.
+		///\return false if the virtual_path does not exist, the buffer is too small, or uses an unsupported compression.
+		bool getData(const std::string &virtual_path, char *buffer, std::size_t capacity, std::size_t &size) const;
+		bool getData(const Entry *entry, char *buffer, std::size_t capacity, std::size_t &size) const;
+		bool getData(const char *virtual_path, std::size_t virtual_path_size, char *buffer, std::size_t capacity, std::size_t &size) const;
+
+		///\brief Extracts the data of many files with one batch of reads.
+		///
+		/// The entries are read in archive order, and entries that lie within merge_gap bytes
+		/// of each other are merged into a single read. On Linux with io_uring up to setQueueDepth() reads
+		/// are in flight at once, and each file is decompressed as soon as its read completes.
+		///\param entries The entries to extract, in any order.
+		///\param [out] data The data of each entry, in the same order as entries. The data size is Entry::decompressed_size.
+		///                   Entries that failed are null, the rest are allocated from resource.
+		///\param merge_gap (optional) The largest number of unused bytes to read in order to merge two reads.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
+		///\return false if any of the entries failed.
+		bool getData(const EntryList &entries, std::vector<char*> &data, std::size_t merge_gap = DEFAULT_MERGE_GAP, MemoryResource *resource = nullptr) const;
+		bool getData(const EntryList &entries, std::vector<Buffer> &data, std::size_t merge_gap = DEFAULT_MERGE_GAP, MemoryResource *resource = nullptr) const;
+
+		///\brief Tells the OS that files will be read soon, so it can start reading them in.
+		///
+		/// The ranges of the entries are merged like in the batched getData(), and for every range
+		/// posix_fadvise() is used on files and madvise() on mappings. Archives in memory that aren't
+		/// mapped are already resident, so nothing is done for them. Returns right away.
+		///\param entries The entries, in any order.
+		///\param merge_gap (optional) The largest number of unused bytes to include in order to merge two ranges.
+		void prefetch(const EntryList &entries, std::size_t merge_gap = DEFAULT_MERGE_GAP) const;
+
+		///\brief Tells the OS that a range of the archive will be read soon.
+		///\param offset Position in the archive.
+		///\param size Number of bytes.
+		void prefetch(std::uint64_t offset, std::uint64_t size) const;
+
+		///\brief Tells the OS that files won't be read again soon, so their cached pages can be dropped.
+		///
+		/// Pages are only dropped from the page cache or the mapping, the archive stays usable.
+		///\param entries The entries, in any order.
+		///\param merge_gap (optional) The largest number of unused bytes to include in order to merge two ranges.
+		void release(const EntryList &entries, std::size_t merge_gap = DEFAULT_MERGE_GAP) const;
+
+		///\brief Tells the OS that a range of the archive won't be read again soon.
+		///\param offset Position in the archive.
+		///\param size Number of bytes.
+		void release(std::uint64_t offset, std::uint64_t size) const;
 
 		///\brief Extracts the raw data of a file.
 		///
 		/// If the archive is compressed, this will return the compressed data.
 		/// If not, this will return the same as getData.
 		///\param virtual_path Full pathname of the virtual file.
-		///\param [out] data The data, untouched if failed.
+		///\param [out] data The data, untouched if failed. Allocated from resource, size bytes.
 		///\param [out] size The data size, untouched if failed.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
+		///\return false if the virtual_path does not exist.
+		bool getRawData(const std::string &virtual_path, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+		bool getRawData(const Entry *entry, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+		bool getRawData(const char *virtual_path, std::size_t virtual_path_size, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+
+		///\brief Extracts the raw data of a file into an owning buffer.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param [out] buffer The data, untouched if failed.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
 		///\return false if the virtual_path does not exist.
-		bool getRawData(const std::string &virtual_path, char *&data, std::size_t &size) const;
-		bool getRawData(const Entry *entry, char *&data, std::size_t &size) const;
+		bool getRawData(const std::string &virtual_path, Buffer &buffer, MemoryResource *resource = nullptr) const;
+		bool getRawData(const Entry *entry, Buffer &buffer, MemoryResource *resource = nullptr) const;
+		bool getRawData(const char *virtual_path, std::size_t virtual_path_size, Buffer &buffer, MemoryResource *resource = nullptr) const;
+
+		///\brief Extracts the raw data of a file into a buffer provided by the caller.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param [out] buffer Buffer to write the data to, needs to hold at least Entry::compressed_size bytes.
+		///\param capacity Size of the buffer in bytes.
+		///\param [out] size The data size, untouched if failed.
+		///\return false if the virtual_path does not exist, or the buffer is too small.
+		bool getRawData(const std::string &virtual_path, char *buffer, std::size_t capacity, std::size_t &size) const;
+		bool getRawData(const Entry *entry, char *buffer, std::size_t capacity, std::size_t &size) const;
+		bool getRawData(const char *virtual_path, std::size_t virtual_path_size, char *buffer, std::size_t capacity, std::size_t &size) const;
+
+		///\brief Reads the raw data of many files straight into buffers provided by the caller.
+		///
+		/// Entries that follow each other in the archive are read with a single preadv(), which scatters
+		/// the data over their buffers without an intermediate copy. Archives in memory are copied from.
+		///\param [in,out] targets The entries and their buffers, in any order. Sets ReadTarget::success.
+		///\return false if any of the entries failed, because it is null, or its buffer is too small.
+		bool getRawData(ReadTargetList &targets) const;
+
+		///\brief Gets a view of the data of a file, without copying it.
+		///
+		/// Uncompressed archives that are held in memory, which is all but the ones opened with openFile(),
+		/// are viewed directly. For other archives the data is loaded into a shared buffer, or taken from the cache,
+		/// see setCache(). Threads that ask for an entry that is already being loaded wait for that load and share
+		/// its buffer, so a burst of requests for the same entry costs a single read and decompression.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param [out] view The view, untouched if failed.
+		///\return false if the virtual_path does not exist, or the data can't be loaded.
+		bool getView(const std::string &virtual_path, View &view) const;
+		bool getView(const Entry *entry, View &view) const;
+
+		///\brief Gets a view of the raw data of a file, without copying it.
+		///
+		/// If the archive is compressed, the view will contain the compressed data.
+		/// Only works for archives that are held in memory, which is all but the ones opened with openFile().
+		///\param virtual_path Full pathname of the virtual file.
+		///\param [out] view The view, untouched if failed.
+		///\return false if the virtual_path does not exist, or the archive isn't held in memory.
+		bool getRawView(const std::string &virtual_path, View &view) const;
+		bool getRawView(const Entry *entry, View &view) const;
+
+		///\brief Extracts the first bytes of a file, like a header, without decompressing the rest.
+		///
+		/// Only the compressed bytes needed for the prefix are read, and decompression stops after prefix_size bytes.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param prefix_size Number of bytes to extract, files that are smaller are extracted whole.
+		///\param [out] data The data, untouched if failed. Allocated from resource, size bytes.
+		///\param [out] size The data size, the smaller of prefix_size and Entry::decompressed_size, untouched if failed.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
+		///\return false if the virtual_path does not exist.
+		bool getDataPrefix(const std::string &virtual_path, std::size_t prefix_size, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+		bool getDataPrefix(const Entry *entry, std::size_t prefix_size, char *&data, std::size_t &size, MemoryResource *resource = nullptr) const;
+
+		///\brief Extracts the first bytes of a file into an owning buffer.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param prefix_size Number of bytes to extract, files that are smaller are extracted whole.
+		///\param [out] buffer The data, untouched if failed.
+		///\param resource (optional) Resource to allocate the data from, null for the archive's, see setMemoryResource().
+		///\return false if the virtual_path does not exist.
+		bool getDataPrefix(const std::string &virtual_path, std::size_t prefix_size, Buffer &buffer, MemoryResource *resource = nullptr) const;
+		bool getDataPrefix(const Entry *entry, std::size_t prefix_size, Buffer &buffer, MemoryResource *resource = nullptr) const;
+
+		///\brief Extracts the first bytes of a file into a buffer provided by the caller.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param prefix_size Number of bytes to extract, files that are smaller are extracted whole.
+		///\param [out] buffer Buffer to write the data to, needs to hold the smaller of prefix_size and Entry::decompressed_size.
+		///\param capacity Size of the buffer in bytes.
+		///\param [out] size The data size, untouched if failed.
+		///\return false if the virtual_path does not exist, or the buffer is too small.
+		bool getDataPrefix(const std::string &virtual_path, std::size_t prefix_size, char *buffer, std::size_t capacity, std::size_t &size) const;
+		bool getDataPrefix(const Entry *entry, std::size_t prefix_size, char *buffer, std::size_t capacity, std::size_t &size) const;
+
+		///\brief Sets up a cache of decompressed entries.
+		///
+		/// getData(), getView() and loadAsync() look entries up in the cache first, and add them to it when they are loaded.
+		/// Concurrent misses on the same entry are loaded once, as they are without a cache.
+		/// The cache is emptied when the archive is closed, and replaced by the next call.
+		/// Should not be called while other threads use the archive.
+		///\param budget Largest number of bytes to cache, 0 removes the cache.
+		///\param policy The eviction policy.
+		void setCache(std::size_t budget, CachePolicy policy = CachePolicy::SEGMENTED_LRU);
+
+		///\brief Returns the counters of the cache, all zero without one.
+		CacheStats getCacheStats() const;
+
+		///\brief Sets the resource that buffers are allocated from.
+		///
+		/// Used for returned buffers, unless a call is given a resource of its own, and for buffers the archive
+		/// uses internally: the copy made by openMemory(), the staging of compressed data read from a file,
+		/// the buffers of EntryReader, and the buffers behind views and the cache.
+		/// The resource must outlive the archive and everything allocated from it, which includes the results
+		/// of loadAsync(). Should not be changed while the archive is open.
+		///\param resource The resource, or null for getDefaultResource(), which works with new[] and delete[].
+		void setMemoryResource(MemoryResource *resource);
+
+		///\brief Returns the resource that buffers are allocated from.
+		MemoryResource *getMemoryResource() const;
+
+		///\brief Sets the worker pool that asynchronous loads are run on.
+		///
+		/// Should not be changed while loads are running.
+		///\param pool The pool, or null to use WorkerPool::getDefault().
+		void setWorkerPool(WorkerPool *pool);
+
+		///\brief Sets how many reads of a batch are in flight at once, for archives opened with openFile().
+		///
+		/// Only used by builds with io_uring, where every thread that reads a batch keeps a ring this deep.
+		/// 0 reads batches one read at a time, like builds without io_uring.
+		/// Should not be changed while other threads use the archive.
+		///\param depth Number of reads, DEFAULT_QUEUE_DEPTH by default.
+		void setQueueDepth(unsigned depth);
+
+		///\brief Returns how many reads of a batch are in flight at once.
+		unsigned getQueueDepth() const;
+
+		///\brief Loads the data of a file on a worker thread.
+		///
+		/// The archive waits for all of its loads to finish before it is closed,
+		/// so it must not be closed from a load callback. Exceptions thrown by the memory resource fail the load.
+		/// Loads of an entry that is already being loaded, by another load or by getData() or getView(),
+		/// wait for that load and copy its data, so the entry is read and decompressed once.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param group (optional) Group to add the load to, must outlive the load.
+		///\return A future that is set when the load has finished, failed, or was cancelled.
+		std::future<LoadResult> loadAsync(const std::string &virtual_path, LoadGroup *group = nullptr) const;
+		std::future<LoadResult> loadAsync(const Entry *entry, LoadGroup *group = nullptr) const;
+
+		///\brief Loads the data of a file on a worker thread, and calls a callback with the result.
+		///
+		/// The callback is called on the worker thread, also when the load failed or was cancelled.
+		///\param virtual_path Full pathname of the virtual file.
+		///\param callback The callback.
+		///\param group (optional) Group to add the load to, must outlive the load.
+		void loadAsync(const std::string &virtual_path, LoadCallback callback, LoadGroup *group = nullptr) const;
+		void loadAsync(const Entry *entry, LoadCallback callback, LoadGroup *group = nullptr) const;
 
 		///\brief Returns a pointer to the Entry of a file.
 		///\param virtual_path Full pathname of the virtual file.
 		///\return null if the virtual_path does not exist.
 		const Entry *getEntry(const std::string &virtual_path) const;
 
+		///\brief Returns a pointer to the Entry of a file, without allocating.
+		///
+		/// Works with anything that holds a pointer and a length, like a std::string_view.
+		///\param virtual_path Full pathname of the virtual file, does not need to be zero terminated.
+		///\param virtual_path_size Length of the pathname.
+		///\return null if the virtual_path does not exist.
+		const Entry *getEntry(const char *virtual_path, std::size_t virtual_path_size) const;
+
+		///\brief Returns a pointer to the Entry of a file, by the hash of its path.
+		///
+		/// No strings are touched, so engines can look up assets by hashes computed ahead of time.
+		/// Archives built by ArchiveBuilder have no two paths with the same hash. For other archives
+		/// the first entry with the hash is returned.
+		///\param hash Hash of the full pathname of the virtual file, see hashPath().
+		///\return null if no path has the hash.
+		const Entry *getEntryByHash(std::uint64_t hash) const;
+
 		///\brief Returns the number of files in the archive.
 		std::size_t getFileCount() const;
 
 		///\brief Gets the list of files in the archive.
-		///\param [out] list The list.
+		///
+		/// The order is unspecified, archives with a perfect hash list their files in the order of its slots.
+		/// Sort the list by Entry::virtual_path or Entry::index when the order matters.
+		///\param [out] list The list, the files are added to the end.
 		void getFileList(EntryList &list) const;
 
 	private:
+		friend class EntryReader;
+
 		struct Header
 		{
 			Header() : magic(0), version(0), compression(0) {}
@@ -132,16 +466,65 @@ namespace ZAP
 			std::uint8_t version;
 			std::uint8_t compression;
 		};
-		typedef std::unordered_map<std::string, Entry> EntryMap;
 
-		bool loadStream();
+		bool load();
 		bool parseHeader();
+		void waitForIndex() const;
 		void buildLookupTable();
+		void readTableV1();
+		void readTableV2();
+		void buildSlots();
+		const Entry *findEntry(const char *virtual_path, std::size_t size, std::uint64_t hash) const;
+		const Entry *findEntry(std::uint64_t hash) const;
+		MemoryResource *getResource(MemoryResource *resource) const;
+		bool loadData(const Entry *entry, char *data) const;
+		bool loadShared(const Entry *entry, std::shared_ptr<const char> &data) const;
+		bool loadCoalesced(const Entry *entry, char *data) const;
+		void advise(const EntryList &entries, std::size_t merge_gap, Advice advice) const;
+		void advise(std::uint64_t offset, std::uint64_t size, Advice advice) const;
+		bool read(std::uint64_t offset, char *data, std::size_t size) const;
+		bool readData(const Entry *entry, char *data) const;
+		const char *getMemory(const Entry *entry) const;
 
-		std::istream *stream;
+		std::unique_ptr<File> file;
+		std::shared_ptr<const char> memory;
+		std::size_t memorySize;
+		bool memoryMapped;
+
+		MemoryResource *memoryResource;
+		WorkerPool *workerPool;
+		unsigned queueDepth;
+		std::unique_ptr<EntryCache> cache;
+
+		// Loads that other threads can join, see getView(). Loads into a caller's buffer
+		// only make a shared copy of the data if another load joined them.
+		struct InFlightLoad
+		{
+			std::shared_future<std::shared_ptr<const char>> result;
+			std::size_t joiners;
+		};
+		mutable std::mutex inFlightMutex;
+		mutable std::unordered_map<const Entry*, InFlightLoad> inFlight;
+		mutable LoadGroup pendingLoads;
 
 		Header header;
-		EntryMap lookupTable;
+
+		// Built once per open, in the open, by the first lookup, or by indexThread
+		IndexMode indexMode;
+		std::unique_ptr<std::once_flag> indexBuilt;
+		std::thread indexThread;
+
+		// The lookup table is a flat array of entries, with all paths in one pool (archives in memory
+		// use the paths in place, files of version 2.0 and up read the pool as is). Archives with a perfect hash function
+		// are looked up with it, in place or from tableData, the rest get an open addressing hash table on top
+		// that holds entry index + 1 (0 is empty)
+		std::vector<Entry> entries;
+		std::vector<char> paths;
+		std::vector<std::uint32_t> slots;
+		std::vector<char> tableData;
+		const char *perfectHash;
+		std::uint32_t perfectHashBuckets;
+		std::uint32_t perfectHashSeed;
 	};
 }
 
@@ -23,10 +23,14 @@ THE SOFTWARE.*/
 #define ZAP_ArchiveBuilder_h__
 
 #include <ZAP/Compression.h>
+#include <ZAP/Version.h>
 
+#include <cstdint>
+#include <iosfwd>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace ZAP
 {
@@ -45,7 +49,8 @@ namespace ZAP
 		///\note This method does not check if the file exists.
 		///\param real_path    Path to the file on the filesystem.
 		///\param virtual_path Path to the file in the archive (can be anything).
-		///\return true if the file was added, false if the virtual path already exists.
+		///\return true if the file was added, false if the virtual path already exists,
+		///        or has the same hash as a path that was added before, see hashPath().
 		bool addFile(const std::string &real_path, const std::string &virtual_path);
 
 		///\brief Removes a file from the archive.
@@ -65,23 +70,68 @@ namespace ZAP
 		///\param [out] map The map.
 		void getFileMap(std::map<std::string,std::string> &map) const;
 
+		///\brief Sets whether archives of version 2.0 and later get a minimal perfect hash function.
+		///
+		/// Readers then look paths up in place instead of building a hash table when the archive is opened,
+		/// for a few bytes per file. The lookup table is stored in the order of the function's slots
+		/// instead of in path order. Off by default.
+		///\param enabled Whether to write the perfect hash function.
+		void setPerfectHash(bool enabled);
+
+		///\brief Returns whether a minimal perfect hash function is written, see setPerfectHash().
+		bool getPerfectHash() const;
+
 		///\brief Builds the archive to a file.
 		///\note If a file cannot be found, a zero-length file will be stored.
 		///\param filename Filename to save the archive to.
 		///\param compression (optional) The compression method to use, defaults to none.
+		///\param version (optional) The format version to write, older versions can be read by older readers.
+		/// Versions before 3.0 fail if the archive or one of its files is over 4 GiB.
 		///\return true if it succeeds, false if it fails.
-		bool buildFile(const std::string &filename, Compression compression = Compression::NONE);
+		bool buildFile(const std::string &filename, Compression compression = Compression::NONE, Version version = Version::CURRENT);
 
 		///\brief Builds the archive to memory.
 		///\note If a file cannot be found, a zero-length file will be stored.
 		///\param [out] data The resulting data, untouched if failed.
 		///\param [out] size The resulting size, untouched if failed.
 		///\param compression (optional) The compression method to use, defaults to none.
+		///\param version (optional) The format version to write, older versions can be read by older readers.
+		/// Versions before 3.0 fail if the archive or one of its files is over 4 GiB.
 		///\return true if it succeeds, false if it fails.
-		bool buildMemory(char *&data, std::size_t &size, Compression compression = Compression::NONE);
+		bool buildMemory(char *&data, std::size_t &size, Compression compression = Compression::NONE, Version version = Version::CURRENT);
+
+		///\brief Builds the archive to a stream in a single forward pass.
+		///
+		/// The lookup table is written after the data, with its position in a trailer at the end,
+		/// so the stream is never seeked and can be a pipe or a socket.
+		///\note If a file cannot be found, a zero-length file will be stored.
+		///\param stream The stream to write to, from its current position on. Positions in the archive are relative to it.
+		///\param compression (optional) The compression method to use, defaults to none.
+		///\param version (optional) The format version to write, 2.0 or later.
+		///\return true if it succeeds, false if it fails.
+		bool buildStream(std::ostream &stream, Compression compression = Compression::NONE, Version version = Version::CURRENT);
 
 	private:
-		bool build(std::ostream &stream, Compression compression);
+		struct Entry;
+		struct Record
+		{
+			Record() : entry(nullptr), order(0), index(0), original_filesize(0), archive_filesize(0) {}
+			Record(const Entry *entry, std::uint32_t order) : entry(entry), order(order), index(0), original_filesize(0), archive_filesize(0) {}
+			const Entry *entry;
+			std::uint32_t order; // Position in path order
+			std::uint64_t index;
+			std::uint64_t original_filesize;
+			std::uint64_t archive_filesize;
+		};
+		struct PerfectHash
+		{
+			PerfectHash() : seed(0) {}
+			std::uint32_t seed;
+			std::vector<std::uint32_t> displacements;
+		};
+
+		bool build(std::ostream &stream, Compression compression, Version version, bool footer);
+		void writeTable(std::ostream &stream, Version version, const std::vector<Record> &records, const PerfectHash &perfectHash) const;
 
 		struct Entry
 		{
@@ -96,6 +146,8 @@ namespace ZAP
 		};
 		typedef std::set<Entry> FileList;
 		FileList files;
+		std::set<std::uint64_t> hashes;
+		bool writePerfectHash;
 	};
 }
 
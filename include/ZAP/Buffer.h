@@ -0,0 +1,85 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_Buffer_h__
+#define ZAP_Buffer_h__
+
+#include <ZAP/MemoryResource.h>
+
+#include <cstddef>
+
+namespace ZAP
+{
+	///\brief Owning, move-only handle to a buffer allocated from a MemoryResource.
+	///
+	/// Frees the buffer through its resource when destroyed, so buffers from a BufferPool go back to the pool.
+	class Buffer
+	{
+	public:
+		///\brief Creates an empty buffer.
+		Buffer();
+
+		///\brief Allocates an uninitialized buffer, check isEmpty() for failure.
+		///\param size Size in bytes.
+		///\param resource (optional) Resource to allocate from, null uses getDefaultResource().
+		explicit Buffer(std::size_t size, MemoryResource *resource = nullptr);
+
+		///\brief Takes ownership of a buffer.
+		///\param data The buffer, allocated from resource with size bytes.
+		///\param size Size in bytes.
+		///\param resource The resource that data was allocated from.
+		Buffer(char *data, std::size_t size, MemoryResource *resource);
+
+		Buffer(Buffer &&other);
+		Buffer &operator=(Buffer &&other);
+
+		///\brief Frees the buffer.
+		~Buffer();
+
+		///\brief Frees the buffer, leaving it empty.
+		void reset();
+
+		///\brief Gives up ownership of the buffer, leaving it empty.
+		///\return The buffer, to be freed with getResource()->deallocate(data, getSize()) as read before calling this.
+		char *release();
+
+		///\brief Returns the data, null if empty.
+		char *getData();
+		///\brief Returns the data, null if empty.
+		const char *getData() const;
+		///\brief Returns the size in bytes, 0 if empty.
+		std::size_t getSize() const;
+		///\brief Returns the resource that the buffer is freed through.
+		MemoryResource *getResource() const;
+		///\brief Returns whether there is no buffer.
+		bool isEmpty() const;
+
+	private:
+		Buffer(const Buffer&) = delete;
+		Buffer &operator=(const Buffer&) = delete;
+
+		char *data;
+		std::size_t size;
+		MemoryResource *resource;
+	};
+}
+
+#endif // ZAP_Buffer_h__
@@ -22,7 +22,10 @@ THE SOFTWARE.*/
 #ifndef ZAP_Compression_h__
 #define ZAP_Compression_h__
 
+#include <ZAP/MemoryResource.h>
+
 #include <cstdint>
+#include <iosfwd>
 
 ///\brief ZAssetPackage.
 namespace ZAP
@@ -39,20 +42,62 @@ namespace ZAP
 	bool supportsCompression(Compression compression);
 
 	///\brief Compress data.
+	///
+	/// LZ4 takes at most LZ4_MAX_INPUT_SIZE (a little below 2 GiB) bytes at once, compress larger data from a stream.
 	///\param compression    The compression method.
-	///\param [in,out] data  The data to compress. This will be delete[]d and replaced with the compressed data.
+	///\param [in,out] data  The data to compress, allocated from resource. This will be freed and replaced with the compressed data,
+	///                       a buffer of out_size bytes from resource.
 	///\param in_size        Size of the decompressed data.
 	///\param [out] out_size Size of the compressed data.
+	///\param resource       (optional) Resource data is allocated from, null for getDefaultResource(), which works with new[] and delete[].
 	///\return true if it succeeds, false if it fails.
-	bool compress(Compression compression, char *&data, std::uint32_t in_size, std::uint32_t &out_size);
+	bool compress(Compression compression, char *&data, std::uint64_t in_size, std::uint64_t &out_size, MemoryResource *resource = nullptr);
+
+	///\brief Compress data from a stream to another, a chunk at a time.
+	///
+	/// Only a chunk of the data is held in memory at once, whatever its size. The result is the same
+	/// format the other overload produces, so it can be decompressed with decompress() or read with EntryReader.
+	///\param compression    The compression method.
+	///\param in             The stream to read from its current position. Needs to support seeking, as LZ4 reads parts of the data twice.
+	///\param in_size        Number of bytes to read.
+	///\param out            The stream to write the compressed data to.
+	///\param [out] out_size Size of the compressed data.
+	///\return false if reading, compressing or writing fails, the streams are left at wherever it stopped.
+	bool compress(Compression compression, std::istream &in, std::uint64_t in_size, std::ostream &out, std::uint64_t &out_size);
 
 	///\brief Decompress data.
 	///\param compression   The compression method.
-	///\param [in,out] data The data to decompress. This will be delete[]d and replaced with the decompressed data.
+	///\param [in,out] data The data to decompress, allocated from resource. This will be freed and replaced with the decompressed data.
 	///\param in_size       Size of the compressed data.
 	///\param out_size      Size of the decompressed data.
+	///\param resource      (optional) Resource data is allocated from, null for getDefaultResource(), which works with new[] and delete[].
 	///\return true if it succeeds, false if it fails.
-	bool decompress(Compression compression, char *&data, std::uint32_t in_size, std::uint32_t out_size);
+	bool decompress(Compression compression, char *&data, std::uint64_t in_size, std::uint64_t out_size, MemoryResource *resource = nullptr);
+
+	///\brief Decompress data into a buffer.
+	///\param compression   The compression method.
+	///\param in_data       The data to decompress.
+	///\param in_size       Size of the compressed data.
+	///\param [out] out_data Buffer to write the decompressed data to, needs to hold out_size bytes.
+	///\param out_size      Size of the decompressed data.
+	///\return true if it succeeds, false if it fails.
+	bool decompress(Compression compression, const char *in_data, std::uint64_t in_size, char *out_data, std::uint64_t out_size);
+
+	///\brief Returns the largest number of compressed bytes needed to decompress the first bytes of the data.
+	///
+	/// This is a bound for typical data, decompressPrefix() can still fail on data that needs more.
+	///\param compression The compression method.
+	///\param out_size    Number of decompressed bytes.
+	std::uint64_t getPrefixInputBound(Compression compression, std::uint64_t out_size);
+
+	///\brief Decompress only the first bytes of data.
+	///\param compression   The compression method.
+	///\param in_data       The data to decompress, can be cut short.
+	///\param in_size       Size of in_data, at most the size of the compressed data.
+	///\param [out] out_data Buffer to write the decompressed data to, needs to hold out_size bytes.
+	///\param out_size      Number of bytes to decompress, at most the size of the decompressed data.
+	///\return false if it fails, or in_data doesn't hold enough to decompress out_size bytes.
+	bool decompressPrefix(Compression compression, const char *in_data, std::uint64_t in_size, char *out_data, std::uint64_t out_size);
 }
 
 #endif // ZAP_Compression_h__
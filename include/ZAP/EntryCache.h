@@ -0,0 +1,136 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_EntryCache_h__
+#define ZAP_EntryCache_h__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ZAP
+{
+	///\brief The eviction policies of EntryCache.
+	enum class CachePolicy
+	{
+		LRU           = 0, ///< Evicts the least recently used entry.
+		SEGMENTED_LRU = 1, ///< Keeps entries that were used more than once apart, so a scan over many entries can't evict them.
+	};
+
+	///\brief Counters of an EntryCache.
+	struct CacheStats
+	{
+		std::uint64_t hits;      ///< Number of lookups that found their entry.
+		std::uint64_t misses;    ///< Number of lookups that did not.
+		std::uint64_t evictions; ///< Number of entries evicted to stay within the budget.
+		std::size_t size;        ///< Bytes currently held.
+		std::size_t budget;      ///< Largest number of bytes held.
+	};
+
+	///\brief Byte-budgeted cache of decompressed entries.
+	///
+	/// The cache is split into shards with a lock each, so threads looking up different entries rarely
+	/// wait on each other. The budget is shared by all shards, so a single entry can take all of it.
+	/// Data is reference counted, so evicting an entry never frees data that is still in use.
+	class EntryCache
+	{
+	public:
+		///\brief Creates an empty cache.
+		///\param budget Largest number of bytes to hold.
+		///\param policy The eviction policy.
+		EntryCache(std::size_t budget, CachePolicy policy);
+
+		///\brief Looks up an entry.
+		///\param key The entry.
+		///\param [out] data The data, untouched if not found.
+		///\param [out] size The data size, untouched if not found.
+		///\return false if the entry isn't cached.
+		bool find(std::size_t key, std::shared_ptr<const char> &data, std::size_t &size);
+
+		///\brief Adds an entry, evicting others until it fits.
+		///
+		/// Evicts the entries used longest ago from any shard. Threads that insert at the same time
+		/// can take the cache over budget for a moment. Entries larger than the budget are not cached.
+		///\param key The entry.
+		///\param data The data.
+		///\param size The data size.
+		void insert(std::size_t key, std::shared_ptr<const char> data, std::size_t size);
+
+		///\brief Removes all entries, the counters are kept.
+		void clear();
+
+		///\brief Returns the counters, summed over all shards.
+		CacheStats getStats() const;
+
+		///\brief Returns the eviction policy.
+		CachePolicy getPolicy() const;
+
+	private:
+		EntryCache(const EntryCache&) = delete;
+		EntryCache &operator=(const EntryCache&) = delete;
+
+		struct Node
+		{
+			std::size_t key;
+			std::shared_ptr<const char> data;
+			std::size_t size;
+			std::uint64_t lastUse;
+			bool isProtected;
+		};
+		typedef std::list<Node> NodeList;
+
+		// With SEGMENTED_LRU, new entries start out probationary and are protected on their second use.
+		// With LRU, only the probationary list is used.
+		struct Shard
+		{
+			Shard() : size(0), protectedSize(0), hits(0), misses(0), evictions(0) {}
+			std::mutex mutex;
+			NodeList probationary;
+			NodeList protectedNodes;
+			std::unordered_map<std::size_t, NodeList::iterator> nodes;
+			std::size_t size;
+			std::size_t protectedSize;
+			std::uint64_t hits;
+			std::uint64_t misses;
+			std::uint64_t evictions;
+		};
+
+		Shard &getShard(std::size_t key);
+		void evict(std::size_t needed);
+		void evictOldest(Shard &shard);
+
+		std::size_t budget;
+		CachePolicy policy;
+		std::vector<std::unique_ptr<Shard>> shards;
+
+		// Totals over all shards, so the budget holds for the whole cache
+		std::atomic<std::size_t> totalSize;
+		std::atomic<std::size_t> totalProtectedSize;
+		std::atomic<std::uint64_t> clock;
+	};
+}
+
+#endif // ZAP_EntryCache_h__
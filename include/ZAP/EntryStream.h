@@ -0,0 +1,181 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_EntryStream_h__
+#define ZAP_EntryStream_h__
+
+#include <ZAP/Archive.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace ZAP
+{
+	///\brief Reads a single file of an archive a piece at a time, with a fixed amount of memory.
+	///
+	/// Compressed data is pulled from the archive through a small input window and decompressed
+	/// incrementally, so a file is never held in memory as a whole. The buffers are allocated from
+	/// the archive's memory resource when a file is opened. The archive must stay open
+	/// while the reader is used. A reader must only be used by one thread at a time,
+	/// but any number of readers can read from the same archive at once.
+	class EntryReader
+	{
+	public:
+		///\brief Number of compressed bytes read from the archive at a time.
+		static const std::size_t INPUT_SIZE = 64 * 1024;
+
+		///\brief Size of the window that data is decompressed to, twice the LZ4 match distance.
+		static const std::size_t WINDOW_SIZE = 128 * 1024;
+
+		EntryReader();
+
+		///\brief Constructor that calls open().
+		EntryReader(const Archive &archive, const Archive::Entry *entry);
+
+		///\brief Starts reading a file.
+		///\param archive The archive, must stay open while reading.
+		///\param entry The file to read.
+		///\return false if the entry is null, or the archive's compression isn't supported.
+		/// If the buffers can't be allocated, it returns true and the reader has failed.
+		bool open(const Archive &archive, const Archive::Entry *entry);
+
+		///\brief Stops reading and releases the buffers.
+		void close();
+
+		///\brief Checks if a file is being read.
+		bool isOpen() const;
+
+		///\brief Reads the next bytes of the file.
+		///\param [out] data Buffer to read to, needs to hold size bytes.
+		///\param size Number of bytes to read.
+		///\return The number of bytes read, less than size at the end of the file or on failure.
+		std::size_t read(char *data, std::size_t size);
+
+		///\brief Reads the next bytes of the file without copying them.
+		///\param [out] data The bytes, valid until the next call to the reader.
+		///\return The number of bytes, 0 at the end of the file or on failure.
+		std::size_t readChunk(const char *&data);
+
+		///\brief Checks if all of the file has been read.
+		bool isEnd() const;
+
+		///\brief Checks if reading failed, because of a read error or broken compressed data.
+		bool hasFailed() const;
+
+		///\brief Returns the number of bytes read so far.
+		std::uint64_t getPosition() const;
+
+		///\brief Returns the size of the file in bytes.
+		std::uint64_t getSize() const;
+
+	private:
+		EntryReader(const EntryReader&) = delete;
+		EntryReader &operator=(const EntryReader&) = delete;
+
+		enum class State
+		{
+			TOKEN,
+			LITERAL_LENGTH,
+			LITERALS,
+			OFFSET,
+			MATCH_LENGTH,
+			MATCH,
+			DONE,
+			FAILED
+		};
+
+		bool fill();
+		bool fillInput();
+		bool nextByte(std::uint8_t &byte);
+		void decode();
+		void decodeSequences();
+		static bool readLength(const char *&in, const char *end, std::size_t &length);
+		void fail();
+
+		const Archive *archive;
+		const Archive::Entry *entry;
+		Compression compression;
+		State state;
+
+		// Archives in memory are read in place and keep their memory alive,
+		// everything else goes through the input window
+		std::shared_ptr<const char> memory;
+		std::unique_ptr<char[], ResourceDeleter> inputBuffer;
+		const char *input;
+		std::size_t inputPos;
+		std::size_t inputEnd;
+		std::uint64_t compressedRead;
+
+		// Decompressed data, of which the last WINDOW_SIZE / 2 bytes are kept as history for matches
+		std::unique_ptr<char[], ResourceDeleter> window;
+		const char *output;
+		std::size_t outputPos;
+		std::size_t outputEnd;
+		std::uint64_t decompressedRead;
+		std::uint64_t decompressed;
+
+		std::size_t literalLength;
+		std::size_t matchLength;
+		std::size_t matchOffset;
+		unsigned offsetBytes;
+	};
+
+	///\brief Stream buffer that reads a single file of an archive with an EntryReader.
+	class EntryStreamBuffer : public std::streambuf
+	{
+	public:
+		EntryStreamBuffer(const Archive &archive, const Archive::Entry *entry);
+
+		///\brief Returns the reader, to check for failures.
+		const EntryReader &getReader() const;
+
+	protected:
+		int_type underflow() override;
+		std::streamsize showmanyc() override;
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+
+	private:
+		EntryReader reader;
+	};
+
+	///\brief Input stream over a single file of an archive, with bounded memory.
+	///
+	/// Only telling the position is supported, not seeking. If the file can't be read or its
+	/// compressed data is broken, the stream ends early and hasFailed() returns true.
+	class EntryStream : public std::istream
+	{
+	public:
+		EntryStream(const Archive &archive, const Archive::Entry *entry);
+		EntryStream(const Archive &archive, const std::string &virtual_path);
+
+		///\brief Checks if reading failed, as opposed to reaching the end of the file.
+		bool hasFailed() const;
+
+	private:
+		EntryStreamBuffer buffer;
+	};
+}
+
+#endif // ZAP_EntryStream_h__
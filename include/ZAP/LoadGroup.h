@@ -0,0 +1,72 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_LoadGroup_h__
+#define ZAP_LoadGroup_h__
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace ZAP
+{
+	///\brief Tracks a group of asynchronous loads, so they can be waited on or cancelled together.
+	///
+	/// To be able to cancel a single load, give it a group of its own.
+	class LoadGroup
+	{
+	public:
+		LoadGroup();
+
+		///\brief Waits for all loads in the group to finish.
+		~LoadGroup();
+
+		///\brief Waits until all loads in the group have finished, including their callbacks.
+		void wait();
+
+		///\brief Cancels all loads in the group that haven't started yet.
+		///
+		/// Cancelled loads still finish, with LoadResult::cancelled set.
+		/// Loads added to the group after this are not affected.
+		void cancel();
+
+		///\brief Returns the number of loads in the group that haven't finished.
+		std::size_t getPendingCount() const;
+
+	private:
+		friend class Archive;
+
+		LoadGroup(const LoadGroup&) = delete;
+		LoadGroup &operator=(const LoadGroup&) = delete;
+
+		std::uint64_t begin();
+		bool isCancelled(std::uint64_t generation) const;
+		void end();
+
+		mutable std::mutex mutex;
+		std::condition_variable condition;
+		std::size_t pending;
+		std::uint64_t generation;
+	};
+}
+
+#endif // ZAP_LoadGroup_h__
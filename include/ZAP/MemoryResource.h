@@ -0,0 +1,184 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_MemoryResource_h__
+#define ZAP_MemoryResource_h__
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace ZAP
+{
+	///\brief Interface for allocating the buffers the library returns and uses internally.
+	///
+	/// Modeled after std::pmr::memory_resource, which isn't available in C++11.
+	/// Implementations must be thread-safe if archives using them are used from several threads.
+	class MemoryResource
+	{
+	public:
+		virtual ~MemoryResource();
+
+		///\brief Allocates memory.
+		///\param bytes Number of bytes.
+		///\param alignment Alignment of the memory, a power of two.
+		///\return The memory, or null if it can't be allocated.
+		void *allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+		///\brief Frees memory from allocate().
+		///\param data The memory.
+		///\param bytes Number of bytes, as passed to allocate().
+		///\param alignment Alignment of the memory, as passed to allocate().
+		void deallocate(void *data, std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+		///\brief Checks if memory from one resource can be freed by the other.
+		bool isEqual(const MemoryResource &other) const;
+
+	protected:
+		virtual void *doAllocate(std::size_t bytes, std::size_t alignment) = 0;
+		virtual void doDeallocate(void *data, std::size_t bytes, std::size_t alignment) = 0;
+		virtual bool doIsEqual(const MemoryResource &other) const;
+	};
+
+	///\brief Returns the resource used when none is given.
+	///
+	/// It allocates with new char[], so buffers from it can also be freed with delete[].
+	MemoryResource *getDefaultResource();
+
+	///\brief Frees a char buffer through the resource it came from, for use with std::unique_ptr.
+	struct ResourceDeleter
+	{
+		ResourceDeleter() : resource(nullptr), size(0) {}
+		ResourceDeleter(MemoryResource *resource, std::size_t size) : resource(resource), size(size) {}
+
+		void operator()(char *data) const
+		{
+			if (data != nullptr)
+				resource->deallocate(data, size);
+		}
+
+		MemoryResource *resource;
+		std::size_t size;
+	};
+
+	///\brief Arena that hands out memory from large chunks and frees all of it at once.
+	///
+	/// deallocate() does nothing, the memory is only freed by release() or the destructor.
+	/// Suits data with a shared lifetime, like all assets of a level.
+	class MonotonicResource : public MemoryResource
+	{
+	public:
+		///\brief Creates an empty arena.
+		///\param chunk_size Size of the chunks taken from upstream, larger allocations get a chunk of their own.
+		///\param upstream (optional) Resource to take the chunks from, null uses getDefaultResource().
+		explicit MonotonicResource(std::size_t chunk_size = 1024 * 1024, MemoryResource *upstream = nullptr);
+
+		///\brief Frees all memory.
+		~MonotonicResource();
+
+		///\brief Frees all memory that was allocated from the arena.
+		void release();
+
+		///\brief Returns the number of bytes taken from upstream.
+		std::size_t getReservedSize() const;
+
+	protected:
+		void *doAllocate(std::size_t bytes, std::size_t alignment) override;
+		void doDeallocate(void *data, std::size_t bytes, std::size_t alignment) override;
+
+	private:
+		MonotonicResource(const MonotonicResource&) = delete;
+		MonotonicResource &operator=(const MonotonicResource&) = delete;
+
+		struct Chunk
+		{
+			void *data;
+			std::size_t size;
+		};
+
+		mutable std::mutex mutex;
+		MemoryResource *upstream;
+		std::size_t chunkSize;
+		std::vector<Chunk> chunks;
+		char *current;
+		std::size_t left;
+	};
+
+	///\brief Counters of a BufferPool.
+	struct BufferPoolStats
+	{
+		BufferPoolStats() : allocations(0), deallocations(0), reuses(0), size(0), budget(0) {}
+		std::uint64_t allocations;   ///< Number of allocations passed on to upstream.
+		std::uint64_t deallocations; ///< Number of deallocations passed on to upstream.
+		std::uint64_t reuses;        ///< Number of allocations served from a free list.
+		std::size_t size;            ///< Bytes held in the free lists.
+		std::size_t budget;          ///< Most bytes the free lists may hold.
+	};
+
+	///\brief Pool that recycles freed buffers through size-class free lists.
+	///
+	/// Requests are rounded up to a size class, four per power of two, so at most a quarter of a buffer is unused.
+	/// Freed buffers are kept for the next request of the same class, until the free lists hold budget bytes.
+	/// Loading same-sized data over and over then no longer allocates from upstream once the lists are warm.
+	class BufferPool : public MemoryResource
+	{
+	public:
+		///\brief Creates an empty pool.
+		///\param budget Most bytes to keep in the free lists, further freed buffers go back to upstream.
+		///\param upstream (optional) Resource to take the buffers from, null uses getDefaultResource().
+		explicit BufferPool(std::size_t budget = 64 * 1024 * 1024, MemoryResource *upstream = nullptr);
+
+		///\brief Frees the buffers in the free lists. Buffers still in use must not be freed afterwards.
+		~BufferPool();
+
+		///\brief Frees the buffers in the free lists.
+		void trim();
+
+		///\brief Returns the counters.
+		BufferPoolStats getStats() const;
+
+		///\brief Returns the size class that a request is rounded up to, or bytes itself if it's too large to pool.
+		static std::size_t getClassSize(std::size_t bytes);
+
+	protected:
+		void *doAllocate(std::size_t bytes, std::size_t alignment) override;
+		void doDeallocate(void *data, std::size_t bytes, std::size_t alignment) override;
+
+	private:
+		BufferPool(const BufferPool&) = delete;
+		BufferPool &operator=(const BufferPool&) = delete;
+
+		static const std::size_t MIN_CLASS_SHIFT = 6;  // 64 bytes
+		static const std::size_t MAX_CLASS_SHIFT = 30; // 1 GiB
+		static const std::size_t CLASS_COUNT = (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT) * 4 + 1;
+
+		static std::size_t getClass(std::size_t bytes);
+		static std::size_t getSizeOfClass(std::size_t c);
+
+		mutable std::mutex mutex;
+		MemoryResource *upstream;
+		std::vector<void*> freeLists[CLASS_COUNT];
+		BufferPoolStats stats;
+	};
+}
+
+#endif // ZAP_MemoryResource_h__
@@ -0,0 +1,42 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_PathHash_h__
+#define ZAP_PathHash_h__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ZAP
+{
+	///\brief Hashes a virtual path with 64-bit FNV-1a.
+	///
+	/// The hash is part of the archive format, so it is the same on every platform and in every version
+	/// of the library. Engines can hash asset names ahead of time and look them up with Archive::getEntryByHash().
+	///\param path The path, does not need to be zero terminated.
+	///\param size Length of the path.
+	///\return The hash.
+	std::uint64_t hashPath(const char *path, std::size_t size);
+	std::uint64_t hashPath(const std::string &path);
+}
+
+#endif // ZAP_PathHash_h__
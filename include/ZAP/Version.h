@@ -27,10 +27,12 @@ namespace ZAP
 	///\brief Versions of the archive format.
 	enum class Version
 	{
-		V1_0    = 0,    ///< Version 1.0.
+		V1_0    = 0,    ///< Version 1.0, entries with zero terminated paths.
+		V2_0    = 1,    ///< Version 2.0, fixed-size entries with a separate path pool.
+		V3_0    = 2,    ///< Version 3.0, like 2.0 with 64-bit file offsets and sizes, for archives and files over 4 GiB.
 		MIN     = V1_0, ///< The minimum version supported.
-		MAX     = V1_0, ///< The maximum version supported.
-		CURRENT = MAX   ///< The default version.
+		MAX     = V3_0, ///< The maximum version supported.
+		CURRENT = V2_0  ///< The default version, which readers without 3.0 support can read. Archives over 4 GiB need V3_0.
 	};
 }
 
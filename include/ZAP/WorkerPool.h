@@ -0,0 +1,74 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_WorkerPool_h__
+#define ZAP_WorkerPool_h__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ZAP
+{
+	///\brief Pool of worker threads that asynchronous loads are run on.
+	///
+	/// Workers both read and decompress, so the thread that starts a load never waits on either.
+	class WorkerPool
+	{
+	public:
+		typedef std::function<void()> Task;
+
+		///\brief Starts the worker threads.
+		///\param thread_count Number of worker threads, 0 uses the number of hardware threads.
+		explicit WorkerPool(std::size_t thread_count = 0);
+
+		///\brief Runs all queued tasks and stops the worker threads.
+		~WorkerPool();
+
+		///\brief Returns the number of worker threads.
+		std::size_t getThreadCount() const;
+
+		///\brief Queues a task to run on one of the worker threads.
+		///\param task The task.
+		void submit(Task task);
+
+		///\brief Returns the pool used by archives that haven't been given one.
+		static WorkerPool &getDefault();
+
+	private:
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool &operator=(const WorkerPool&) = delete;
+
+		void run();
+
+		std::vector<std::thread> threads;
+		std::deque<Task> tasks;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping;
+	};
+}
+
+#endif // ZAP_WorkerPool_h__
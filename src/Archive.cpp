@@ -20,34 +20,178 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.*/
 #include <ZAP/Archive.h>
+#include <ZAP/EntryStream.h>
+#include <ZAP/PathHash.h>
+#include <ZAP/WorkerPool.h>
+#include "File.h"
+#include "PerfectHash.h"
+#include "Scan.h"
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <utility>
 
 namespace
 {
-	const std::istream::pos_type MAGIC_POS = 0;
-	const std::istream::pos_type TABLE_POS = 4;
+	const std::uint64_t MAGIC_POS = 0;
+	const std::uint64_t TABLE_POS = 4;
+
+	// Version 2.0 lookup table: entry count, path pool size and flags, followed by
+	// fixed-size entries (path offset, path size, file index, original size, archive size) padded to TABLE_ALIGNMENT,
+	// the path hashes if TABLE_FLAG_HASHES is set, the perfect hash function if TABLE_FLAG_PERFECT_HASH is set,
+	// and the path pool. Version 3.0 is the same with a 64-bit file index and sizes.
+	const std::size_t TABLE_V2_HEADER_SIZE = 3 * sizeof(std::uint32_t);
+	const std::size_t TABLE_V2_ENTRY_SIZE = 5 * sizeof(std::uint32_t);
+	const std::size_t TABLE_V3_ENTRY_SIZE = 2 * sizeof(std::uint32_t) + 3 * sizeof(std::uint64_t);
+	// The entries start on a multiple of this, and the hashes after them too
+	const std::uint64_t TABLE_ALIGNMENT = 8;
+
+	// The entries and paths follow the data, with their position in the last 8 bytes of the archive
+	const std::uint32_t TABLE_FLAG_FOOTER = 1;
+	// Every entry has a 64-bit hash of its path, see hashPath()
+	const std::uint32_t TABLE_FLAG_HASHES = 2;
+	// The hashes are followed by a minimal perfect hash function (bucket count, seed and a displacement per bucket),
+	// that maps the path of every entry to the index of the entry
+	const std::uint32_t TABLE_FLAG_PERFECT_HASH = 4;
+	const std::uint32_t TABLE_FLAGS_KNOWN = TABLE_FLAG_FOOTER | TABLE_FLAG_HASHES | TABLE_FLAG_PERFECT_HASH;
 
 	const std::uint16_t MAGIC_CHARS = 'AZ';
 
+	// Batched reads are never merged beyond this, so large batches still pipeline
+	const std::uint64_t MAX_MERGED_READ = 8 * 1024 * 1024;
+
+	// Lookup tables in files are read in chunks of this size
+	const std::size_t TABLE_CHUNK_SIZE = 1024 * 1024;
+
+	// Files with more compressed data are decompressed through an EntryReader instead of being staged,
+	// so a load never allocates more than this on top of its output
+	const std::uint64_t MAX_STAGED_SIZE = 64 * 1024 * 1024;
+
 	template<typename T>
-	inline void readField(std::istream *stream, T *field)
+	inline void readField(const char *data, T *field)
+	{
+		std::memcpy(field, data, sizeof(T));
+	}
+
+	// Sequential access to the lookup table. Archives in memory are parsed in place,
+	// files are read a large chunk at a time and parsed from the chunk.
+	class TableReader
+	{
+	public:
+		TableReader(const char *data, std::size_t size, std::uint64_t offset)
+			: file(nullptr), fileOffset(0), begin(data + offset), end(data + size)
+		{
+		}
+		TableReader(const ZAP::File &file, std::uint64_t offset)
+			: file(&file), fileOffset(offset), begin(nullptr), end(nullptr)
+		{
+		}
+
+		// Returns the number of bytes left in the archive
+		std::uint64_t getRemaining() const
+		{
+			return static_cast<std::uint64_t>(end - begin) + (file != nullptr ? file->getSize() - fileOffset : 0);
+		}
+
+		// Returns a pointer to count bytes at the cursor, or null if the archive ends first
+		const char *peek(std::size_t count)
+		{
+			if (static_cast<std::size_t>(end - begin) < count && !refill(count))
+				return nullptr;
+			return begin;
+		}
+
+		// Finds the length of the zero terminated string at the cursor
+		bool findTerminator(std::size_t &length)
+		{
+			std::size_t searched = 0;
+			for (;;)
+			{
+				std::size_t available = static_cast<std::size_t>(end - begin);
+				if (available > searched)
+				{
+					std::size_t found = searched + ZAP::findTerminator(begin + searched, available - searched);
+					if (found < available)
+					{
+						length = found;
+						return true;
+					}
+				}
+
+				searched = available;
+				if (!refill(searched + 1))
+					return false;
+			}
+		}
+
+		void skip(std::size_t count)
+		{
+			begin += count;
+		}
+
+	private:
+		// Makes at least count bytes available at the cursor
+		bool refill(std::size_t count)
+		{
+			if (file == nullptr || count > getRemaining())
+				return false;
+
+			std::size_t kept = static_cast<std::size_t>(end - begin);
+			std::uint64_t fileLeft = file->getSize() - fileOffset;
+			std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(std::max(TABLE_CHUNK_SIZE, count - kept), fileLeft));
+
+			// Whatever is left of the last chunk is moved to the front, in front of the next chunk
+			std::vector<char> next(kept + chunk);
+			if (kept != 0)
+				std::memcpy(next.data(), begin, kept);
+			if (!file->read(fileOffset, next.data() + kept, chunk))
+				return false;
+
+			buffer.swap(next);
+			fileOffset += chunk;
+			begin = buffer.data();
+			end = buffer.data() + buffer.size();
+			return true;
+		}
+
+		const ZAP::File *file;
+		std::uint64_t fileOffset;
+		std::vector<char> buffer;
+		const char *begin;
+		const char *end;
+	};
+
+	// Whether data can be held in memory as a whole, which only files over 4 GiB in 32-bit builds can't
+	inline bool fitsInMemory(std::uint64_t size)
+	{
+		return (size <= std::numeric_limits<std::size_t>::max());
+	}
+
+	// Compressed data read from a file is staged in a buffer of the archive's resource,
+	// which is freed as soon as the load finishes
+	typedef std::unique_ptr<char[], ZAP::ResourceDeleter> StagingBuffer;
+
+	StagingBuffer allocateStaging(ZAP::MemoryResource *resource, std::size_t size)
 	{
-		stream->read(reinterpret_cast<char*>(field), sizeof(T));
+		return StagingBuffer(static_cast<char*>(resource->allocate(size)), ZAP::ResourceDeleter(resource, size));
 	}
 }
 
 namespace ZAP
 {
-	Archive::Archive() : stream(nullptr)
+	const std::size_t Archive::DEFAULT_MERGE_GAP;
+	const unsigned Archive::DEFAULT_QUEUE_DEPTH;
+
+	Archive::Archive() : memorySize(0), memoryMapped(false), memoryResource(getDefaultResource()), workerPool(nullptr), queueDepth(DEFAULT_QUEUE_DEPTH), indexMode(IndexMode::IMMEDIATE), perfectHash(nullptr), perfectHashBuckets(0), perfectHashSeed(0)
 	{
 	}
-	Archive::Archive(const std::string &filename) : stream(nullptr)
+	Archive::Archive(const std::string &filename) : memorySize(0), memoryMapped(false), memoryResource(getDefaultResource()), workerPool(nullptr), queueDepth(DEFAULT_QUEUE_DEPTH), indexMode(IndexMode::IMMEDIATE), perfectHash(nullptr), perfectHashBuckets(0), perfectHashSeed(0)
 	{
 		openFile(filename);
 	}
-	Archive::Archive(const char *data, std::size_t size) : stream(nullptr)
+	Archive::Archive(const char *data, std::size_t size) : memorySize(0), memoryMapped(false), memoryResource(getDefaultResource()), workerPool(nullptr), queueDepth(DEFAULT_QUEUE_DEPTH), indexMode(IndexMode::IMMEDIATE), perfectHash(nullptr), perfectHashBuckets(0), perfectHashSeed(0)
 	{
 		openMemory(data, size);
 	}
@@ -58,29 +202,86 @@ namespace ZAP
 
 	bool Archive::openFile(const std::string &filename)
 	{
-		std::ifstream *file = new std::ifstream(filename, std::ios::in | std::ios::binary);
-		if (!file->is_open())
+		close();
+
+		file.reset(new File());
+		if (!file->open(filename))
+		{
+			file.reset();
+			return false;
+		}
+
+		return load();
+	}
+	bool Archive::openMappedFile(const std::string &filename)
+	{
+		close();
+
+		if (!mapFile(filename, memory, memorySize))
 		{
 			return false;
 		}
-		stream = file;
-		return loadStream();
+		memoryMapped = true;
+		return load();
 	}
 	bool Archive::openMemory(const char *data, std::size_t size)
 	{
-		stream = new std::istringstream(std::string(data, size), std::ios::in | std::ios::binary);
-		return loadStream();
+		close();
+
+		char *copy = static_cast<char*>(memoryResource->allocate(size));
+		if (copy == nullptr)
+			return false;
+		std::memcpy(copy, data, size);
+
+		memory = std::shared_ptr<const char>(copy, ResourceDeleter(memoryResource, size));
+		memorySize = size;
+		return load();
+	}
+	bool Archive::openBorrowedMemory(const char *data, std::size_t size)
+	{
+		close();
+
+		// The caller owns the memory, so there is nothing to free
+		memory = std::shared_ptr<const char>(data, [](const char*) {});
+		memorySize = size;
+		return load();
 	}
 	void Archive::close()
 	{
-		delete stream;
-		stream = nullptr;
+		pendingLoads.wait();
+
+		if (indexThread.joinable())
+			indexThread.join();
+		indexBuilt.reset();
+
+		if (cache)
+			cache->clear();
+
+		file.reset();
+		memory.reset();
+		memorySize = 0;
+		memoryMapped = false;
 		header = Header();
-		lookupTable.clear();
+		entries.clear();
+		paths.clear();
+		slots.clear();
+		tableData.clear();
+		perfectHash = nullptr;
+		perfectHashBuckets = 0;
+		perfectHashSeed = 0;
+	}
+	void Archive::setIndexMode(IndexMode mode)
+	{
+		indexMode = mode;
+	}
+	Archive::IndexMode Archive::getIndexMode() const
+	{
+		return indexMode;
 	}
+
 	bool Archive::isOpen() const
 	{
-		return (stream != nullptr);
+		return (file != nullptr || memory != nullptr);
 	}
 
 	Compression Archive::getCompression() const
@@ -99,143 +300,1279 @@ namespace ZAP
 
 	bool Archive::hasFile(const std::string &virtual_path) const
 	{
-		return (lookupTable.find(virtual_path) != lookupTable.cend());
+		return (getEntry(virtual_path) != nullptr);
+	}
+	bool Archive::hasFile(const char *virtual_path, std::size_t virtual_path_size) const
+	{
+		return (getEntry(virtual_path, virtual_path_size) != nullptr);
 	}
 
-	bool Archive::getData(const std::string &virtual_path, char *&data, std::size_t &size) const
+	bool Archive::getData(const std::string &virtual_path, char *&data, std::size_t &size, MemoryResource *resource) const
 	{
-		return getData(getEntry(virtual_path), data, size);
+		return getData(getEntry(virtual_path), data, size, resource);
 	}
-	bool Archive::getData(const Entry *entry, char *&return_data, std::size_t &return_size) const
+	bool Archive::getData(const char *virtual_path, std::size_t virtual_path_size, char *&data, std::size_t &size, MemoryResource *resource) const
 	{
-		if (entry == nullptr || !isSupportedCompression())
+		return getData(getEntry(virtual_path, virtual_path_size), data, size, resource);
+	}
+	bool Archive::getData(const Entry *entry, char *&return_data, std::size_t &return_size, MemoryResource *resource) const
+	{
+		if (entry == nullptr || entry->decompressed_size == 0)
 			return false;
 
-		if (entry->compressed_size == 0 || entry->decompressed_size == 0)
+		resource = getResource(resource);
+		char *data = static_cast<char*>(resource->allocate(entry->decompressed_size));
+		if (data == nullptr)
 			return false;
-
-		stream->seekg(entry->index);
-
-		char *data = new char[entry->compressed_size];
-		stream->read(data, entry->compressed_size);
-
-		if (!decompress(getCompression(), data, entry->compressed_size, entry->decompressed_size))
+		if (!getData(entry, data, entry->decompressed_size, return_size))
 		{
-			delete[] data;
+			resource->deallocate(data, entry->decompressed_size);
 			return false;
 		}
 
 		return_data = data;
-		return_size = entry->decompressed_size;
 		return true;
 	}
 
-	bool Archive::getRawData(const std::string &virtual_path, char *&data, std::size_t &size) const
+	bool Archive::getData(const std::string &virtual_path, Buffer &buffer, MemoryResource *resource) const
 	{
-		return getRawData(getEntry(virtual_path), data, size);
+		return getData(getEntry(virtual_path), buffer, resource);
 	}
-	bool Archive::getRawData(const Entry *entry, char *&data, std::size_t &size) const
+	bool Archive::getData(const char *virtual_path, std::size_t virtual_path_size, Buffer &buffer, MemoryResource *resource) const
 	{
-		if (entry == nullptr)
+		return getData(getEntry(virtual_path, virtual_path_size), buffer, resource);
+	}
+	bool Archive::getData(const Entry *entry, Buffer &buffer, MemoryResource *resource) const
+	{
+		char *data;
+		std::size_t size;
+		if (!getData(entry, data, size, resource))
 			return false;
 
-		if (entry->compressed_size == 0)
+		buffer = Buffer(data, size, getResource(resource));
+		return true;
+	}
+
+	bool Archive::getData(const std::string &virtual_path, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		return getData(getEntry(virtual_path), buffer, capacity, size);
+	}
+	bool Archive::getData(const char *virtual_path, std::size_t virtual_path_size, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		return getData(getEntry(virtual_path, virtual_path_size), buffer, capacity, size);
+	}
+	bool Archive::getData(const Entry *entry, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		if (entry == nullptr || !isSupportedCompression())
 			return false;
 
-		stream->seekg(entry->index);
+		if (entry->compressed_size == 0 || entry->decompressed_size == 0)
+			return false;
 
-		size = entry->compressed_size;
-		data = new char[entry->compressed_size];
-		stream->read(data, entry->compressed_size);
+		if (capacity < entry->decompressed_size)
+			return false;
+
+		if (cache)
+		{
+			std::shared_ptr<const char> cached;
+			if (!loadShared(entry, cached))
+				return false;
+
+			std::memcpy(buffer, cached.get(), entry->decompressed_size);
+		}
+		else if (!loadCoalesced(entry, buffer))
+		{
+			return false;
+		}
+
+		size = entry->decompressed_size;
 		return true;
 	}
 
-	const Archive::Entry *Archive::getEntry(const std::string &virtual_path) const
+	bool Archive::getData(const EntryList &entries, std::vector<char*> &data, std::size_t merge_gap, MemoryResource *resource) const
 	{
-		if (!isOpen())
-			return nullptr;
+		resource = getResource(resource);
+		data.assign(entries.size(), nullptr);
+		if (!isSupportedCompression())
+			return false;
 
-		EntryMap::const_iterator it = lookupTable.find(virtual_path);
-		if (it == lookupTable.cend())
-			return nullptr;
+		const bool compressed = (getCompression() != Compression::NONE);
+		bool success = true;
+
+		// Visit the entries in archive order, so reads move forward through the file
+		std::vector<std::size_t> order;
+		std::vector<std::size_t> streamed;
+		order.reserve(entries.size());
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			const Entry *entry = entries[i];
+			if (entry == nullptr || entry->compressed_size == 0 || entry->decompressed_size == 0 || (!compressed && entry->compressed_size != entry->decompressed_size) ||
+				!fitsInMemory(entry->compressed_size) || !fitsInMemory(entry->decompressed_size))
+			{
+				success = false;
+				continue;
+			}
+
+			// Too large to stage, these are decompressed a piece at a time after the batch, see loadData()
+			if (file && compressed && entry->compressed_size > MAX_STAGED_SIZE)
+				streamed.push_back(i);
+			else
+				order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [&entries](std::size_t lhs, std::size_t rhs)
+		{
+			return (entries[lhs]->index < entries[rhs]->index);
+		});
+
+		if (!file)
+		{
+			// There are no syscalls to save for archives in memory
+			for (std::size_t i : order)
+			{
+				std::size_t size;
+				if (!getData(entries[i], data[i], size, resource))
+					success = false;
+			}
+			return success;
+		}
+
+		// Merge entries that are close enough together into a single read
+		struct Range
+		{
+			std::size_t first; // Into order
+			std::size_t last;  // Into order, inclusive
+		};
+		std::vector<Range> ranges;
+		std::vector<File::ReadRequest> requests;
+
+		for (std::size_t o = 0; o < order.size(); ++o)
+		{
+			const Entry *entry = entries[order[o]];
+			std::uint64_t begin = entry->index;
+			std::uint64_t end = begin + entry->compressed_size;
+
+			if (!requests.empty())
+			{
+				File::ReadRequest &request = requests.back();
+				std::uint64_t requestEnd = request.offset + request.size;
+				if (begin <= requestEnd + merge_gap && std::max(end, requestEnd) - request.offset <= MAX_MERGED_READ)
+				{
+					request.size = static_cast<std::size_t>(std::max(end, requestEnd) - request.offset);
+					ranges.back().last = o;
+					continue;
+				}
+			}
+
+			File::ReadRequest request = { begin, nullptr, static_cast<std::size_t>(entry->compressed_size), false };
+			requests.push_back(request);
+			Range range = { o, o };
+			ranges.push_back(range);
+		}
+
+		// Lone uncompressed entries are read straight into their output,
+		// everything else is staged in one buffer so every read can be in flight at once
+		std::size_t stagingSize = 0;
+		for (std::size_t r = 0; r < ranges.size(); ++r)
+		{
+			if (compressed || ranges[r].first != ranges[r].last)
+				stagingSize += requests[r].size;
+		}
+		std::unique_ptr<char[], ResourceDeleter> staging(stagingSize > 0 ? static_cast<char*>(memoryResource->allocate(stagingSize)) : nullptr,
+			ResourceDeleter(memoryResource, stagingSize));
+		if (stagingSize > 0 && staging == nullptr)
+			return false;
+
+		char *stagingData = staging.get();
+		for (std::size_t r = 0; r < ranges.size(); ++r)
+		{
+			for (std::size_t o = ranges[r].first; o <= ranges[r].last; ++o)
+			{
+				data[order[o]] = static_cast<char*>(resource->allocate(entries[order[o]]->decompressed_size));
+				if (data[order[o]] == nullptr)
+				{
+					for (std::size_t i = 0; i < entries.size(); ++i)
+					{
+						if (data[i] != nullptr)
+							resource->deallocate(data[i], entries[i]->decompressed_size);
+					}
+					data.assign(entries.size(), nullptr);
+					return false;
+				}
+			}
+
+			if (compressed || ranges[r].first != ranges[r].last)
+			{
+				requests[r].data = stagingData;
+				stagingData += requests[r].size;
+			}
+			else
+			{
+				requests[r].data = data[order[ranges[r].first]];
+			}
+		}
+
+		file->read(requests.data(), requests.size(), queueDepth, [&](File::ReadRequest &request)
+		{
+			const Range &range = ranges[&request - requests.data()];
+			for (std::size_t o = range.first; o <= range.last; ++o)
+			{
+				std::size_t i = order[o];
+				const Entry *entry = entries[i];
+				const char *source = request.data + (entry->index - request.offset);
 
-		return &(*it).second;
+				if (request.success)
+				{
+					if (compressed)
+					{
+						if (decompress(getCompression(), source, entry->compressed_size, data[i], entry->decompressed_size))
+							continue;
+					}
+					else
+					{
+						if (source != data[i])
+							std::memcpy(data[i], source, entry->compressed_size);
+						continue;
+					}
+				}
+
+				if (data[i] != nullptr)
+					resource->deallocate(data[i], entry->decompressed_size);
+				data[i] = nullptr;
+				success = false;
+			}
+		});
+
+		for (std::size_t i : streamed)
+		{
+			std::size_t size;
+			if (!getData(entries[i], data[i], size, resource))
+				success = false;
+		}
+
+		return success;
 	}
 
-	std::size_t Archive::getFileCount() const
+	bool Archive::getData(const EntryList &entries, std::vector<Buffer> &data, std::size_t merge_gap, MemoryResource *resource) const
 	{
-		return lookupTable.size();
+		std::vector<char*> loaded;
+		bool success = getData(entries, loaded, merge_gap, resource);
+
+		resource = getResource(resource);
+		data.clear();
+		data.reserve(entries.size());
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			if (loaded[i] != nullptr)
+				data.emplace_back(loaded[i], entries[i]->decompressed_size, resource);
+			else
+				data.emplace_back();
+		}
+		return success;
 	}
 
-	void Archive::getFileList(EntryList &list) const
+	bool Archive::getRawData(const std::string &virtual_path, char *&data, std::size_t &size, MemoryResource *resource) const
+	{
+		return getRawData(getEntry(virtual_path), data, size, resource);
+	}
+	bool Archive::getRawData(const char *virtual_path, std::size_t virtual_path_size, char *&data, std::size_t &size, MemoryResource *resource) const
+	{
+		return getRawData(getEntry(virtual_path, virtual_path_size), data, size, resource);
+	}
+	bool Archive::getRawData(const Entry *entry, char *&data, std::size_t &size, MemoryResource *resource) const
 	{
-		list.reserve(lookupTable.size());
-		for (EntryMap::const_reference mapRef : lookupTable)
+		if (entry == nullptr || entry->compressed_size == 0)
+			return false;
+
+		resource = getResource(resource);
+		char *raw = static_cast<char*>(resource->allocate(entry->compressed_size));
+		if (raw == nullptr)
+			return false;
+		if (!getRawData(entry, raw, entry->compressed_size, size))
 		{
-			const Entry &entry = mapRef.second;
-			list.push_back(&entry);
+			resource->deallocate(raw, entry->compressed_size);
+			return false;
 		}
+
+		data = raw;
+		return true;
 	}
 
-	bool Archive::loadStream()
+	bool Archive::getRawData(const std::string &virtual_path, Buffer &buffer, MemoryResource *resource) const
 	{
-		if (!parseHeader())
-		{
-			close();
+		return getRawData(getEntry(virtual_path), buffer, resource);
+	}
+	bool Archive::getRawData(const char *virtual_path, std::size_t virtual_path_size, Buffer &buffer, MemoryResource *resource) const
+	{
+		return getRawData(getEntry(virtual_path, virtual_path_size), buffer, resource);
+	}
+	bool Archive::getRawData(const Entry *entry, Buffer &buffer, MemoryResource *resource) const
+	{
+		char *data;
+		std::size_t size;
+		if (!getRawData(entry, data, size, resource))
+			return false;
+
+		buffer = Buffer(data, size, getResource(resource));
+		return true;
+	}
+
+	bool Archive::getRawData(const std::string &virtual_path, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		return getRawData(getEntry(virtual_path), buffer, capacity, size);
+	}
+	bool Archive::getRawData(const char *virtual_path, std::size_t virtual_path_size, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		return getRawData(getEntry(virtual_path, virtual_path_size), buffer, capacity, size);
+	}
+	bool Archive::getRawData(const Entry *entry, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		if (entry == nullptr)
 			return false;
+
+		if (entry->compressed_size == 0 || capacity < entry->compressed_size)
+			return false;
+
+		if (!readData(entry, buffer))
+			return false;
+
+		size = entry->compressed_size;
+		return true;
+	}
+
+	bool Archive::getRawData(ReadTargetList &targets) const
+	{
+		bool success = true;
+
+		std::vector<std::size_t> order;
+		order.reserve(targets.size());
+		for (std::size_t i = 0; i < targets.size(); ++i)
+		{
+			ReadTarget &target = targets[i];
+			target.success = false;
+			if (target.entry == nullptr || target.buffer == nullptr || target.entry->compressed_size == 0 || target.capacity < target.entry->compressed_size)
+			{
+				success = false;
+				continue;
+			}
+			order.push_back(i);
 		}
-		else
+
+		if (!file)
 		{
-			buildLookupTable();
-			return true;
+			for (std::size_t i : order)
+			{
+				targets[i].success = readData(targets[i].entry, targets[i].buffer);
+				success &= targets[i].success;
+			}
+			return success;
+		}
+
+		std::sort(order.begin(), order.end(), [&targets](std::size_t lhs, std::size_t rhs)
+		{
+			return (targets[lhs].entry->index < targets[rhs].entry->index);
+		});
+
+		// Every run of entries that directly follow each other is one read
+		std::vector<File::Segment> segments;
+		for (std::size_t first = 0; first < order.size();)
+		{
+			const Entry *entry = targets[order[first]].entry;
+			std::uint64_t end = entry->index + entry->compressed_size;
+
+			segments.clear();
+			File::Segment segment = { targets[order[first]].buffer, static_cast<std::size_t>(entry->compressed_size) };
+			segments.push_back(segment);
+
+			std::size_t last = first + 1;
+			for (; last < order.size() && targets[order[last]].entry->index == end; ++last)
+			{
+				const ReadTarget &target = targets[order[last]];
+				File::Segment next = { target.buffer, static_cast<std::size_t>(target.entry->compressed_size) };
+				segments.push_back(next);
+				end += target.entry->compressed_size;
+			}
+
+			bool done = file->read(entry->index, segments.data(), segments.size());
+			for (std::size_t o = first; o < last; ++o)
+				targets[order[o]].success = done;
+			success &= done;
+
+			first = last;
 		}
+
+		return success;
 	}
-	bool Archive::parseHeader()
+
+	bool Archive::getDataPrefix(const std::string &virtual_path, std::size_t prefix_size, char *&data, std::size_t &size, MemoryResource *resource) const
+	{
+		return getDataPrefix(getEntry(virtual_path), prefix_size, data, size, resource);
+	}
+	bool Archive::getDataPrefix(const Entry *entry, std::size_t prefix_size, char *&return_data, std::size_t &return_size, MemoryResource *resource) const
 	{
-		// We assume that stream is open
-		stream->seekg(MAGIC_POS);
-		readField(stream, &header.magic);
-		readField(stream, &header.version);
-		readField(stream, &header.compression);
+		if (entry == nullptr || entry->decompressed_size == 0 || prefix_size == 0)
+			return false;
 
-		if (header.magic != MAGIC_CHARS)
+		resource = getResource(resource);
+		std::size_t capacity = static_cast<std::size_t>(std::min<std::uint64_t>(prefix_size, entry->decompressed_size));
+		char *data = static_cast<char*>(resource->allocate(capacity));
+		if (data == nullptr)
 			return false;
-		if (header.version < static_cast<std::uint8_t>(Version::MIN) || header.version > static_cast<std::uint8_t>(Version::MAX))
+		if (!getDataPrefix(entry, prefix_size, data, capacity, return_size))
+		{
+			resource->deallocate(data, capacity);
+			return false;
+		}
+
+		return_data = data;
+		return true;
+	}
+
+	bool Archive::getDataPrefix(const std::string &virtual_path, std::size_t prefix_size, Buffer &buffer, MemoryResource *resource) const
+	{
+		return getDataPrefix(getEntry(virtual_path), prefix_size, buffer, resource);
+	}
+	bool Archive::getDataPrefix(const Entry *entry, std::size_t prefix_size, Buffer &buffer, MemoryResource *resource) const
+	{
+		char *data;
+		std::size_t size;
+		if (!getDataPrefix(entry, prefix_size, data, size, resource))
 			return false;
 
+		buffer = Buffer(data, size, getResource(resource));
 		return true;
 	}
-	void Archive::buildLookupTable()
+
+	bool Archive::getDataPrefix(const std::string &virtual_path, std::size_t prefix_size, char *buffer, std::size_t capacity, std::size_t &size) const
+	{
+		return getDataPrefix(getEntry(virtual_path), prefix_size, buffer, capacity, size);
+	}
+	bool Archive::getDataPrefix(const Entry *entry, std::size_t prefix_size, char *buffer, std::size_t capacity, std::size_t &size) const
 	{
-		// We assume that stream is open
-		stream->seekg(TABLE_POS);
-		lookupTable.clear();
+		if (entry == nullptr || !isSupportedCompression())
+			return false;
 
-		std::uint32_t tableSize = 0;
-		readField(stream, &tableSize);
+		if (entry->compressed_size == 0 || entry->decompressed_size == 0 || prefix_size == 0)
+			return false;
 
-		for (uint32_t i = 0; i < tableSize; ++i)
+		std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(prefix_size, entry->decompressed_size));
+		if (capacity < count)
+			return false;
+
+		const Compression compression = getCompression();
+		if (compression == Compression::NONE)
 		{
-			std::string filename;
+			if (entry->compressed_size != entry->decompressed_size || !read(entry->index, buffer, count))
+				return false;
 
-			char c = '\0';
-			for(;;)
-			{
-				stream->read(&c, 1);
+			size = count;
+			return true;
+		}
 
-				if (c == '\0')
-					break;
+		const char *compressed = getMemory(entry);
+		std::uint64_t compressedSize = entry->compressed_size;
+		StagingBuffer staging;
+		if (compressed == nullptr)
+		{
+			if (memory)
+				return false;
 
-				filename += c;
-			}
+			// Only read as much as the prefix can take up
+			compressedSize = std::min(entry->compressed_size, getPrefixInputBound(compression, count));
+			staging = allocateStaging(memoryResource, static_cast<std::size_t>(compressedSize));
+			if (staging == nullptr || !read(entry->index, staging.get(), static_cast<std::size_t>(compressedSize)))
+				return false;
+			compressed = staging.get();
+		}
 
-			Entry entry {};
-			entry.virtual_path = filename;
-			readField(stream, &entry.index);
-			readField(stream, &entry.decompressed_size);
-			readField(stream, &entry.compressed_size);
+		if (!decompressPrefix(compression, compressed, compressedSize, buffer, count))
+		{
+			if (compressedSize == entry->compressed_size)
+				return false;
 
-			lookupTable.emplace(filename, entry);
+			// The prefix took up more than the bound, so fall back to all of the compressed data
+			if (entry->compressed_size > MAX_STAGED_SIZE)
+			{
+				EntryReader reader(*this, entry);
+				if (reader.read(buffer, count) != count || reader.hasFailed())
+					return false;
+			}
+			else
+			{
+				staging = allocateStaging(memoryResource, static_cast<std::size_t>(entry->compressed_size));
+				if (staging == nullptr || !readData(entry, staging.get()) || !decompressPrefix(compression, staging.get(), entry->compressed_size, buffer, count))
+					return false;
+			}
 		}
+
+		size = count;
+		return true;
+	}
+
+	void Archive::prefetch(const EntryList &entries, std::size_t merge_gap) const
+	{
+		advise(entries, merge_gap, Advice::WILL_NEED);
+	}
+	void Archive::prefetch(std::uint64_t offset, std::uint64_t size) const
+	{
+		advise(offset, size, Advice::WILL_NEED);
+	}
+
+	void Archive::release(const EntryList &entries, std::size_t merge_gap) const
+	{
+		advise(entries, merge_gap, Advice::DONT_NEED);
+	}
+	void Archive::release(std::uint64_t offset, std::uint64_t size) const
+	{
+		advise(offset, size, Advice::DONT_NEED);
+	}
+
+	bool Archive::getView(const std::string &virtual_path, View &view) const
+	{
+		return getView(getEntry(virtual_path), view);
+	}
+	bool Archive::getView(const Entry *entry, View &view) const
+	{
+		if (getCompression() == Compression::NONE && memory)
+			return getRawView(entry, view);
+
+		if (entry == nullptr || !isSupportedCompression())
+			return false;
+
+		if (entry->compressed_size == 0 || entry->decompressed_size == 0)
+			return false;
+
+		std::shared_ptr<const char> loaded;
+		if (!loadShared(entry, loaded))
+			return false;
+
+		view.data = std::move(loaded);
+		view.size = entry->decompressed_size;
+		return true;
+	}
+
+	bool Archive::getRawView(const std::string &virtual_path, View &view) const
+	{
+		return getRawView(getEntry(virtual_path), view);
+	}
+	bool Archive::getRawView(const Entry *entry, View &view) const
+	{
+		if (entry == nullptr || entry->compressed_size == 0)
+			return false;
+
+		const char *data = getMemory(entry);
+		if (data == nullptr)
+			return false;
+
+		// Share ownership of the whole mapping, but point at the entry
+		view.data = std::shared_ptr<const char>(memory, data);
+		view.size = entry->compressed_size;
+		return true;
+	}
+
+	void Archive::setCache(std::size_t budget, CachePolicy policy)
+	{
+		if (budget == 0)
+			cache.reset();
+		else
+			cache.reset(new EntryCache(budget, policy));
+	}
+	CacheStats Archive::getCacheStats() const
+	{
+		if (!cache)
+			return CacheStats();
+
+		return cache->getStats();
+	}
+
+	void Archive::setMemoryResource(MemoryResource *resource)
+	{
+		memoryResource = (resource != nullptr) ? resource : getDefaultResource();
+	}
+	MemoryResource *Archive::getMemoryResource() const
+	{
+		return memoryResource;
+	}
+
+	void Archive::setWorkerPool(WorkerPool *pool)
+	{
+		workerPool = pool;
+	}
+
+	void Archive::setQueueDepth(unsigned depth)
+	{
+		queueDepth = depth;
+	}
+	unsigned Archive::getQueueDepth() const
+	{
+		return queueDepth;
+	}
+
+	std::future<Archive::LoadResult> Archive::loadAsync(const std::string &virtual_path, LoadGroup *group) const
+	{
+		return loadAsync(getEntry(virtual_path), group);
+	}
+	std::future<Archive::LoadResult> Archive::loadAsync(const Entry *entry, LoadGroup *group) const
+	{
+		// std::function has to be copyable, so the promise is shared with the callback
+		std::shared_ptr<std::promise<LoadResult>> promise = std::make_shared<std::promise<LoadResult>>();
+		std::future<LoadResult> future = promise->get_future();
+
+		loadAsync(entry, [promise](LoadResult &result)
+		{
+			promise->set_value(std::move(result));
+		}, group);
+
+		return future;
+	}
+
+	void Archive::loadAsync(const std::string &virtual_path, LoadCallback callback, LoadGroup *group) const
+	{
+		loadAsync(getEntry(virtual_path), std::move(callback), group);
+	}
+	void Archive::loadAsync(const Entry *entry, LoadCallback callback, LoadGroup *group) const
+	{
+		pendingLoads.begin();
+		std::uint64_t generation = (group != nullptr ? group->begin() : 0);
+
+		WorkerPool &pool = (workerPool != nullptr ? *workerPool : WorkerPool::getDefault());
+		pool.submit([this, entry, callback, group, generation]()
+		{
+			LoadResult result;
+			result.entry = entry;
+
+			if (group != nullptr && group->isCancelled(generation))
+			{
+				result.cancelled = true;
+			}
+			else if (entry != nullptr && entry->decompressed_size > 0)
+			{
+				// An exception from the resource fails the load, the callback and the group still have to finish
+				try
+				{
+					result.data = Buffer(entry->decompressed_size, memoryResource);
+					result.success = !result.data.isEmpty() && getData(entry, result.data.getData(), entry->decompressed_size, result.size);
+				}
+				catch (...)
+				{
+					result.success = false;
+				}
+				if (!result.success)
+					result.data.reset();
+			}
+
+			callback(result);
+
+			if (group != nullptr)
+				group->end();
+			pendingLoads.end();
+		});
+	}
+
+	const Archive::Entry *Archive::getEntry(const std::string &virtual_path) const
+	{
+		return getEntry(virtual_path.data(), virtual_path.size());
+	}
+	const Archive::Entry *Archive::getEntry(const char *virtual_path, std::size_t virtual_path_size) const
+	{
+		if (!isOpen() || (virtual_path == nullptr && virtual_path_size > 0))
+			return nullptr;
+
+		waitForIndex();
+		return findEntry(virtual_path, virtual_path_size, hashPath(virtual_path, virtual_path_size));
+	}
+	const Archive::Entry *Archive::getEntryByHash(std::uint64_t hash) const
+	{
+		if (!isOpen())
+			return nullptr;
+
+		waitForIndex();
+		return findEntry(hash);
+	}
+
+	std::size_t Archive::getFileCount() const
+	{
+		waitForIndex();
+		return entries.size();
+	}
+
+	void Archive::getFileList(EntryList &list) const
+	{
+		waitForIndex();
+		list.reserve(list.size() + entries.size());
+		for (const Entry &entry : entries)
+		{
+			list.push_back(&entry);
+		}
+	}
+
+	bool Archive::load()
+	{
+		if (!parseHeader())
+		{
+			close();
+			return false;
+		}
+
+		indexBuilt.reset(new std::once_flag());
+		if (indexMode == IndexMode::IMMEDIATE)
+			waitForIndex();
+		else if (indexMode == IndexMode::BACKGROUND)
+			indexThread = std::thread([this]() { waitForIndex(); });
+
+		return true;
+	}
+	bool Archive::parseHeader()
+	{
+		char data[4];
+		if (!read(MAGIC_POS, data, sizeof(data)))
+			return false;
+
+		readField(data + 0, &header.magic);
+		readField(data + 2, &header.version);
+		readField(data + 3, &header.compression);
+
+		if (header.magic != MAGIC_CHARS)
+			return false;
+		if (header.version < static_cast<std::uint8_t>(Version::MIN) || header.version > static_cast<std::uint8_t>(Version::MAX))
+			return false;
+
+		return true;
+	}
+	void Archive::waitForIndex() const
+	{
+		// The lookup table is only written here, once, and call_once makes it visible to every caller
+		if (indexBuilt)
+			std::call_once(*indexBuilt, [this]() { const_cast<Archive*>(this)->buildLookupTable(); });
+	}
+	void Archive::buildLookupTable()
+	{
+		entries.clear();
+		paths.clear();
+		tableData.clear();
+		perfectHash = nullptr;
+
+		if (getVersion() == Version::V1_0)
+			readTableV1();
+		else
+			readTableV2();
+
+		if (perfectHash == nullptr)
+			buildSlots();
+	}
+	void Archive::readTableV1()
+	{
+		TableReader reader = (memory ? TableReader(memory.get(), memorySize, TABLE_POS) : TableReader(*file, TABLE_POS));
+
+		std::uint32_t tableSize = 0;
+		const char *field = reader.peek(sizeof(tableSize));
+		if (field != nullptr)
+		{
+			readField(field, &tableSize);
+			reader.skip(sizeof(tableSize));
+		}
+
+		// Every entry takes at least 13 bytes, which keeps a broken table size from reserving too much
+		static const std::size_t ENTRY_MIN_SIZE = 1 + 3 * sizeof(std::uint32_t);
+		entries.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(tableSize, reader.getRemaining() / ENTRY_MIN_SIZE)));
+
+		for (uint32_t i = 0; i < tableSize; ++i)
+		{
+			std::size_t length;
+			if (!reader.findTerminator(length))
+				break;
+
+			const char *record = reader.peek(length + ENTRY_MIN_SIZE);
+			if (record == nullptr)
+				break;
+
+			std::uint32_t index, decompressedSize, compressedSize;
+			readField(record + length + 1, &index);
+			readField(record + length + 5, &decompressedSize);
+			readField(record + length + 9, &compressedSize);
+
+			Entry entry {};
+			entry.virtual_path_size = static_cast<std::uint32_t>(length);
+			entry.hash = hashPath(record, length);
+			entry.index = index;
+			entry.decompressed_size = decompressedSize;
+			entry.compressed_size = compressedSize;
+
+			if (memory)
+				entry.virtual_path = record; // Used in place
+			else
+				paths.insert(paths.end(), record, record + length + 1);
+
+			entries.push_back(entry);
+			reader.skip(length + ENTRY_MIN_SIZE);
+		}
+
+		entries.shrink_to_fit();
+		paths.shrink_to_fit();
+
+		if (!memory)
+		{
+			// The pool doesn't move anymore, so the paths can be pointed into it
+			const char *path = paths.data();
+			for (Entry &entry : entries)
+			{
+				entry.virtual_path = path;
+				path += entry.virtual_path_size + 1;
+			}
+		}
+	}
+	void Archive::readTableV2()
+	{
+		char field[TABLE_V2_HEADER_SIZE];
+		if (!read(TABLE_POS, field, sizeof(field)))
+			return;
+
+		std::uint32_t tableSize, poolSize, flags;
+		readField(field + 0, &tableSize);
+		readField(field + 4, &poolSize);
+		readField(field + 8, &flags);
+		if ((flags & ~TABLE_FLAGS_KNOWN) != 0)
+			return;
+		if ((flags & TABLE_FLAG_PERFECT_HASH) && !(flags & TABLE_FLAG_HASHES))
+			return;
+
+		const bool wide = (getVersion() >= Version::V3_0);
+		const std::size_t entrySize = (wide ? TABLE_V3_ENTRY_SIZE : TABLE_V2_ENTRY_SIZE);
+		const std::uint64_t entriesSize = (static_cast<std::uint64_t>(tableSize) * entrySize + TABLE_ALIGNMENT - 1) / TABLE_ALIGNMENT * TABLE_ALIGNMENT;
+		const std::uint64_t hashesSize = (flags & TABLE_FLAG_HASHES) ? static_cast<std::uint64_t>(tableSize) * sizeof(std::uint64_t) : 0;
+		std::uint64_t archiveSize = (memory ? memorySize : file->getSize());
+		std::uint64_t entriesPos = TABLE_POS + TABLE_V2_HEADER_SIZE;
+		if (flags & TABLE_FLAG_FOOTER)
+		{
+			char trailer[sizeof(std::uint64_t)];
+			if (archiveSize < entriesPos + sizeof(trailer) || !read(archiveSize - sizeof(trailer), trailer, sizeof(trailer)))
+				return;
+
+			readField(trailer, &entriesPos);
+			archiveSize -= sizeof(trailer);
+		}
+		if (entriesPos % TABLE_ALIGNMENT != 0 || entriesPos > archiveSize || entriesSize + hashesSize + poolSize > archiveSize - entriesPos)
+			return;
+
+		// The perfect hash function has its size in front
+		std::uint64_t perfectHashSize = 0;
+		std::uint32_t bucketCount = 0;
+		std::uint32_t seed = 0;
+		if (flags & TABLE_FLAG_PERFECT_HASH)
+		{
+			char fields[2 * sizeof(std::uint32_t)];
+			if (entriesSize + hashesSize + sizeof(fields) > archiveSize - entriesPos || !read(entriesPos + entriesSize + hashesSize, fields, sizeof(fields)))
+				return;
+
+			readField(fields + 0, &bucketCount);
+			readField(fields + 4, &seed);
+			if (bucketCount == 0)
+				return;
+
+			perfectHashSize = sizeof(fields) + static_cast<std::uint64_t>(bucketCount) * sizeof(std::uint32_t);
+			if (entriesSize + hashesSize + perfectHashSize + poolSize > archiveSize - entriesPos)
+				return;
+		}
+
+		// Archives in memory are used in place, files take one read for the entries, hashes
+		// and perfect hash function, and one for the pool
+		const std::uint64_t poolPos = entriesPos + entriesSize + hashesSize + perfectHashSize;
+		const char *records;
+		const char *pool;
+		if (memory)
+		{
+			records = memory.get() + entriesPos;
+			pool = memory.get() + poolPos;
+		}
+		else
+		{
+			tableData.resize(static_cast<std::size_t>(entriesSize + hashesSize + perfectHashSize));
+			paths.resize(poolSize);
+			if ((!tableData.empty() && !read(entriesPos, tableData.data(), tableData.size())) ||
+				(poolSize != 0 && !read(poolPos, paths.data(), paths.size())))
+			{
+				tableData.clear();
+				paths.clear();
+				return;
+			}
+			records = tableData.data();
+			pool = paths.data();
+		}
+		const char *hashes = (hashesSize != 0 ? records + entriesSize : nullptr);
+
+		entries.resize(tableSize);
+		for (std::uint32_t i = 0; i < tableSize; ++i)
+		{
+			const char *record = records + static_cast<std::size_t>(i) * entrySize;
+
+			std::uint32_t pathOffset;
+			Entry &entry = entries[i];
+			readField(record + 0, &pathOffset);
+			readField(record + 4, &entry.virtual_path_size);
+			if (wide)
+			{
+				readField(record + 8, &entry.index);
+				readField(record + 16, &entry.decompressed_size);
+				readField(record + 24, &entry.compressed_size);
+			}
+			else
+			{
+				std::uint32_t index, decompressedSize, compressedSize;
+				readField(record + 8, &index);
+				readField(record + 12, &decompressedSize);
+				readField(record + 16, &compressedSize);
+				entry.index = index;
+				entry.decompressed_size = decompressedSize;
+				entry.compressed_size = compressedSize;
+			}
+
+			// Paths need to lie in the pool and be zero terminated, like the ones in version 1.0
+			if (pathOffset >= poolSize || entry.virtual_path_size >= poolSize - pathOffset || pool[pathOffset + entry.virtual_path_size] != '\0')
+			{
+				entries.resize(i);
+				break;
+			}
+			entry.virtual_path = pool + pathOffset;
+
+			// Stored hashes are trusted, so opening doesn't touch the paths at all
+			if (hashes != nullptr)
+				readField(hashes + static_cast<std::size_t>(i) * sizeof(std::uint64_t), &entry.hash);
+			else
+				entry.hash = hashPath(entry.virtual_path, entry.virtual_path_size);
+		}
+
+		// A table that was cut short falls back to the hash table, the function covers all entries or none
+		if (perfectHashSize != 0 && !entries.empty() && entries.size() == tableSize)
+		{
+			perfectHash = records + entriesSize + hashesSize + 2 * sizeof(std::uint32_t);
+			perfectHashBuckets = bucketCount;
+			perfectHashSeed = seed;
+		}
+		if (memory)
+			return;
+
+		// Only the perfect hash function is still needed
+		if (perfectHash != nullptr)
+		{
+			std::size_t offset = static_cast<std::size_t>(perfectHash - tableData.data());
+			tableData.erase(tableData.begin(), tableData.begin() + offset);
+			tableData.shrink_to_fit();
+			perfectHash = tableData.data();
+		}
+		else
+		{
+			tableData.clear();
+			tableData.shrink_to_fit();
+		}
+	}
+	void Archive::buildSlots()
+	{
+		// Keep the load factor at or below a half, so probe sequences stay short
+		std::size_t capacity = 1;
+		while (capacity < entries.size() * 2)
+			capacity <<= 1;
+
+		slots.assign(capacity, 0);
+		std::size_t mask = capacity - 1;
+
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			const Entry &entry = entries[i];
+			if (findEntry(entry.virtual_path, entry.virtual_path_size, entry.hash) != nullptr)
+				continue; // The first of duplicated paths wins
+
+			std::size_t slot = entry.hash & mask;
+			while (slots[slot] != 0)
+				slot = (slot + 1) & mask;
+
+			slots[slot] = static_cast<std::uint32_t>(i + 1);
+		}
+	}
+	const Archive::Entry *Archive::findEntry(const char *virtual_path, std::size_t size, std::uint64_t hash) const
+	{
+		if (perfectHash != nullptr)
+		{
+			// One probe, the entry in the slot is the only one that can match
+			const Entry &entry = entries[findPerfectHashSlot(hash, perfectHashSeed, perfectHash, perfectHashBuckets, static_cast<std::uint32_t>(entries.size()))];
+			if (entry.hash == hash && entry.virtual_path_size == size && std::memcmp(entry.virtual_path, virtual_path, size) == 0)
+				return &entry;
+			return nullptr;
+		}
+
+		if (slots.empty())
+			return nullptr;
+
+		std::size_t mask = slots.size() - 1;
+		for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask)
+		{
+			std::uint32_t index = slots[slot];
+			if (index == 0)
+				return nullptr;
+
+			// The paths are only compared when the hashes match
+			const Entry &entry = entries[index - 1];
+			if (entry.hash == hash && entry.virtual_path_size == size && std::memcmp(entry.virtual_path, virtual_path, size) == 0)
+				return &entry;
+		}
+	}
+	const Archive::Entry *Archive::findEntry(std::uint64_t hash) const
+	{
+		if (perfectHash != nullptr)
+		{
+			const Entry &entry = entries[findPerfectHashSlot(hash, perfectHashSeed, perfectHash, perfectHashBuckets, static_cast<std::uint32_t>(entries.size()))];
+			return (entry.hash == hash ? &entry : nullptr);
+		}
+
+		if (slots.empty())
+			return nullptr;
+
+		std::size_t mask = slots.size() - 1;
+		for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask)
+		{
+			std::uint32_t index = slots[slot];
+			if (index == 0)
+				return nullptr;
+
+			const Entry &entry = entries[index - 1];
+			if (entry.hash == hash)
+				return &entry;
+		}
+	}
+	MemoryResource *Archive::getResource(MemoryResource *resource) const
+	{
+		return (resource != nullptr) ? resource : memoryResource;
+	}
+	bool Archive::loadData(const Entry *entry, char *data) const
+	{
+		if (getCompression() == Compression::NONE)
+		{
+			// Nothing to decompress, so read straight into the buffer
+			return (entry->compressed_size == entry->decompressed_size && readData(entry, data));
+		}
+
+		const char *compressed = getMemory(entry);
+		StagingBuffer staging;
+		if (compressed == nullptr)
+		{
+			if (memory)
+				return false;
+
+			if (entry->compressed_size > MAX_STAGED_SIZE)
+			{
+				EntryReader reader(*this, entry);
+				return (reader.read(data, static_cast<std::size_t>(entry->decompressed_size)) == entry->decompressed_size && !reader.hasFailed());
+			}
+
+			staging = allocateStaging(memoryResource, static_cast<std::size_t>(entry->compressed_size));
+			if (staging == nullptr || !readData(entry, staging.get()))
+				return false;
+			compressed = staging.get();
+		}
+
+		return decompress(getCompression(), compressed, entry->compressed_size, data, entry->decompressed_size);
+	}
+	bool Archive::loadShared(const Entry *entry, std::shared_ptr<const char> &data) const
+	{
+		// Entries are cached by their position in the lookup table, so entries of other archives aren't
+		const bool cacheable = (cache && entry >= entries.data() && entry < entries.data() + entries.size());
+		const std::size_t key = (cacheable ? static_cast<std::size_t>(entry - entries.data()) : 0);
+
+		std::size_t size;
+		if (cacheable && cache->find(key, data, size))
+			return true;
+
+		// Join a load of the same entry that is already running, or start one others can join.
+		// Loads are added to the cache before they are removed from here, so only a load that
+		// finishes right between the cache lookup and taking the lock is done twice.
+		std::promise<std::shared_ptr<const char>> promise;
+		std::unique_lock<std::mutex> lock(inFlightMutex);
+
+		auto found = inFlight.find(entry);
+		if (found != inFlight.end())
+		{
+			++found->second.joiners;
+			std::shared_future<std::shared_ptr<const char>> pending = found->second.result;
+			lock.unlock();
+
+			data = pending.get();
+			return (data != nullptr);
+		}
+
+		InFlightLoad load = { promise.get_future().share(), 0 };
+		inFlight.emplace(entry, load);
+		lock.unlock();
+
+		std::shared_ptr<const char> loaded;
+		try
+		{
+			std::unique_ptr<char[], ResourceDeleter> buffer(fitsInMemory(entry->decompressed_size) ? static_cast<char*>(memoryResource->allocate(entry->decompressed_size)) : nullptr,
+				ResourceDeleter(memoryResource, entry->decompressed_size));
+			if (buffer != nullptr && loadData(entry, buffer.get()))
+			{
+				loaded = std::shared_ptr<const char>(buffer.release(), ResourceDeleter(memoryResource, entry->decompressed_size));
+				if (cacheable)
+					cache->insert(key, loaded, entry->decompressed_size);
+			}
+		}
+		catch (...)
+		{
+			// Loads that joined this one get the exception too, and the next load starts over
+			lock.lock();
+			inFlight.erase(entry);
+			lock.unlock();
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		lock.lock();
+		inFlight.erase(entry);
+		lock.unlock();
+		promise.set_value(loaded);
+
+		data = std::move(loaded);
+		return (data != nullptr);
+	}
+	bool Archive::loadCoalesced(const Entry *entry, char *data) const
+	{
+		// Copying from memory is as cheap as copying from another load
+		if (memory && getCompression() == Compression::NONE)
+			return loadData(entry, data);
+
+		// Join a load of the same entry that is already running, or load straight into data
+		// and share a copy with the loads that joined in the meantime
+		std::promise<std::shared_ptr<const char>> promise;
+		std::unique_lock<std::mutex> lock(inFlightMutex);
+
+		auto found = inFlight.find(entry);
+		if (found != inFlight.end())
+		{
+			++found->second.joiners;
+			std::shared_future<std::shared_ptr<const char>> pending = found->second.result;
+			lock.unlock();
+
+			std::shared_ptr<const char> loaded = pending.get();
+			if (loaded == nullptr)
+				return false;
+
+			std::memcpy(data, loaded.get(), static_cast<std::size_t>(entry->decompressed_size));
+			return true;
+		}
+
+		InFlightLoad load = { promise.get_future().share(), 0 };
+		inFlight.emplace(entry, load);
+		lock.unlock();
+
+		bool success;
+		try
+		{
+			success = loadData(entry, data);
+		}
+		catch (...)
+		{
+			lock.lock();
+			inFlight.erase(entry);
+			lock.unlock();
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		// No load can join once this one is removed, so the joiners are known
+		lock.lock();
+		const std::size_t joiners = inFlight[entry].joiners;
+		inFlight.erase(entry);
+		lock.unlock();
+
+		std::shared_ptr<const char> shared;
+		if (success && joiners > 0)
+		{
+			// The data is already in place for this load, so failing to copy it only fails the ones that joined
+			try
+			{
+				char *copy = static_cast<char*>(memoryResource->allocate(static_cast<std::size_t>(entry->decompressed_size)));
+				if (copy != nullptr)
+				{
+					std::memcpy(copy, data, static_cast<std::size_t>(entry->decompressed_size));
+					shared = std::shared_ptr<const char>(copy, ResourceDeleter(memoryResource, static_cast<std::size_t>(entry->decompressed_size)));
+				}
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+				return true;
+			}
+		}
+		promise.set_value(shared);
+
+		return success;
+	}
+	void Archive::advise(const EntryList &entries, std::size_t merge_gap, Advice advice) const
+	{
+		if (!file && !memoryMapped)
+			return;
+
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+		ranges.reserve(entries.size());
+		for (const Entry *entry : entries)
+		{
+			if (entry != nullptr && entry->compressed_size > 0)
+				ranges.emplace_back(entry->index, entry->index + entry->compressed_size);
+		}
+		std::sort(ranges.begin(), ranges.end());
+
+		// Merge ranges that are close enough together, so there are fewer syscalls
+		std::uint64_t begin = 0, end = 0;
+		for (std::size_t i = 0; i < ranges.size(); ++i)
+		{
+			if (i > 0 && ranges[i].first <= end + merge_gap)
+			{
+				end = std::max(end, ranges[i].second);
+				continue;
+			}
+
+			if (i > 0)
+				advise(begin, end - begin, advice);
+			begin = ranges[i].first;
+			end = ranges[i].second;
+		}
+		if (!ranges.empty())
+			advise(begin, end - begin, advice);
+	}
+	void Archive::advise(std::uint64_t offset, std::uint64_t size, Advice advice) const
+	{
+		if (file)
+		{
+			file->advise(offset, size, advice);
+		}
+		else if (memoryMapped && offset < memorySize)
+		{
+			std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(size, memorySize - offset));
+			adviseMapping(memory.get() + offset, count, advice);
+		}
+	}
+	bool Archive::read(std::uint64_t offset, char *data, std::size_t size) const
+	{
+		if (memory)
+		{
+			if (offset > memorySize || size > memorySize - offset)
+				return false;
+
+			std::memcpy(data, memory.get() + offset, size);
+			return true;
+		}
+
+		return file->read(offset, data, size);
+	}
+	bool Archive::readData(const Entry *entry, char *data) const
+	{
+		return read(entry->index, data, entry->compressed_size);
+	}
+	const char *Archive::getMemory(const Entry *entry) const
+	{
+		if (!memory)
+			return nullptr;
+
+		if (entry->index > memorySize || entry->compressed_size > memorySize - entry->index)
+			return nullptr;
+
+		return memory.get() + entry->index;
 	}
 }
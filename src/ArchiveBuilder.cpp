@@ -20,31 +20,57 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.*/
 #include <ZAP/ArchiveBuilder.h>
+#include <ZAP/PathHash.h>
 #include <ZAP/Version.h>
+#include "PerfectHash.h"
 
 #include <cstdint>
 #include <fstream>
+#include <limits>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
 namespace
 {
 	const std::uint16_t MAGIC_CHARS = 'AZ';
 
-	template<typename T>
-	inline void writeField(std::ostream &stream, const T *field)
+	// Version 2.0 lookup table flag: the entries and paths follow the data, see ArchiveBuilder::buildStream()
+	const std::uint32_t TABLE_FLAG_FOOTER = 1;
+	// Version 2.0 lookup table flag: the entries are followed by the hashes of their paths
+	const std::uint32_t TABLE_FLAG_HASHES = 2;
+	// Version 2.0 lookup table flag: the hashes are followed by a minimal perfect hash function,
+	// and the entries are in the order of the slots it maps their paths to
+	const std::uint32_t TABLE_FLAG_PERFECT_HASH = 4;
+
+	// Version 2.0 entries start on a multiple of this and are padded to one, so the hashes after them are aligned.
+	// Only needs padding for an odd number of entries, version 3.0 entries are a multiple of it themselves.
+	const std::uint64_t TABLE_ALIGNMENT = 8;
+	const std::uint64_t TABLE_V2_ENTRY_SIZE = 5 * sizeof(std::uint32_t);
+
+	inline std::uint64_t getTablePadding(std::uint64_t size)
 	{
-		stream.write(reinterpret_cast<const char*>(field), sizeof(T));
+		return (TABLE_ALIGNMENT - size % TABLE_ALIGNMENT) % TABLE_ALIGNMENT;
 	}
+	void writePadding(std::ostream &stream, std::uint64_t size)
+	{
+		const char zeroes[TABLE_ALIGNMENT] = {};
+		stream.write(zeroes, static_cast<std::streamsize>(size));
+	}
+
+	// Fields are passed by value. With a pointer overload next to this one, passing the address of a
+	// non-const field picked this overload and wrote the address, so pointers are rejected outright.
 	template<typename T>
 	inline void writeField(std::ostream &stream, const T field)
 	{
+		static_assert(std::is_arithmetic<T>::value, "writeField() writes numbers, pass the field by value");
 		stream.write(reinterpret_cast<const char*>(&field), sizeof(T));
 	}
 }
 
 namespace ZAP
 {
-	ArchiveBuilder::ArchiveBuilder()
+	ArchiveBuilder::ArchiveBuilder() : writePerfectHash(false)
 	{
 	}
 	ArchiveBuilder::~ArchiveBuilder()
@@ -53,7 +79,15 @@ namespace ZAP
 
 	bool ArchiveBuilder::addFile(const std::string &real_path, const std::string &virtual_path)
 	{
-		return files.emplace(real_path, virtual_path).second;
+		if (files.count(Entry(real_path, virtual_path)) != 0)
+			return false;
+
+		// Readers look paths up by hash, so two paths with the same hash can't be told apart
+		if (!hashes.insert(hashPath(virtual_path)).second)
+			return false;
+
+		files.emplace(real_path, virtual_path);
+		return true;
 	}
 
 	bool ArchiveBuilder::removeFile(const std::string &virtual_path)
@@ -63,6 +97,7 @@ namespace ZAP
 			const Entry &entry = (*it);
 			if (entry.virtual_path == virtual_path)
 			{
+				hashes.erase(hashPath(entry.virtual_path));
 				files.erase(it);
 				return true;
 			}
@@ -73,6 +108,7 @@ namespace ZAP
 	void ArchiveBuilder::clearFiles()
 	{
 		files.clear();
+		hashes.clear();
 	}
 
 	std::size_t ArchiveBuilder::getFileCount() const
@@ -80,6 +116,15 @@ namespace ZAP
 		return files.size();
 	}
 
+	void ArchiveBuilder::setPerfectHash(bool enabled)
+	{
+		writePerfectHash = enabled;
+	}
+	bool ArchiveBuilder::getPerfectHash() const
+	{
+		return writePerfectHash;
+	}
+
 	void ArchiveBuilder::getFileMap(std::map<std::string,std::string> &map) const
 	{
 		for (const Entry &entry : files)
@@ -88,115 +133,261 @@ namespace ZAP
 		}
 	}
 
-	bool ArchiveBuilder::buildFile(const std::string &filename, Compression compression)
+	bool ArchiveBuilder::buildFile(const std::string &filename, Compression compression, Version version)
 	{
 		std::ofstream stream(filename, std::ios::out | std::ios::trunc | std::ios::binary);
 		if (!stream.is_open())
 		{
 			return false;
 		}
-		return build(stream, compression);
+		return build(stream, compression, version, false);
 	}
-	bool ArchiveBuilder::buildMemory(char *&data, std::size_t &size, Compression compression)
+	bool ArchiveBuilder::buildMemory(char *&data, std::size_t &size, Compression compression, Version version)
 	{
-		std::stringstream stream(std::ios::binary);
-		if (build(stream, compression))
+		// A mode without in or out opens a stream that can be neither written nor read
+		std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+		if (build(stream, compression, version, false))
 		{
 			stream.seekg(0, std::ios::end);
-			size = static_cast<std::size_t>(stream.tellg());
+			std::size_t built = static_cast<std::size_t>(stream.tellg());
 			stream.seekg(0, std::ios::beg);
 
-			data = new char[size];
-			stream.read(data, size);
+			char *result = new char[built];
+			if (!stream.read(result, built))
+			{
+				delete[] result;
+				return false;
+			}
 
+			data = result;
+			size = built;
 			return true;
 		}
 		return false;
 	}
+	bool ArchiveBuilder::buildStream(std::ostream &stream, Compression compression, Version version)
+	{
+		return build(stream, compression, version, true);
+	}
 
-	bool ArchiveBuilder::build(std::ostream &stream, Compression compression)
+	bool ArchiveBuilder::build(std::ostream &stream, Compression compression, Version version, bool footer)
 	{
 		if (!supportsCompression(compression))
 		{
 			return false;
 		}
+		if (version < Version::MIN || version > Version::MAX || (footer && version == Version::V1_0))
+		{
+			return false;
+		}
+
+		// The position is tracked instead of asking the stream, so streams that can't seek work too
+		std::uint64_t position = 0;
 
 		// Header
 		writeField(stream, MAGIC_CHARS); // Magic
-		writeField(stream, static_cast<std::uint8_t>(Version::CURRENT)); // Version
+		writeField(stream, static_cast<std::uint8_t>(version)); // Version
 		writeField(stream, static_cast<std::uint8_t>(compression)); // Compression
+		position += 4;
 
 		// Build lookup table
 		std::uint32_t tableSize = static_cast<std::uint32_t>(files.size());
-		writeField(stream, &tableSize); // Table size
+		writeField(stream, tableSize); // Table size
+		position += sizeof(tableSize);
 
-		std::uint32_t *fillIn = new std::uint32_t[tableSize];
-		std::uint32_t *currFillIn = &fillIn[0];
+		std::vector<Record> records;
+		records.reserve(files.size());
 		for (const Entry &entry : files)
 		{
-			stream.write(entry.virtual_path.c_str(), sizeof(char)*entry.virtual_path.size()+1);
-
-			// We don't know these values yet
-			(*currFillIn) = static_cast<std::uint32_t>(stream.tellp());
-			writeField(stream, 0); // File index
-			writeField(stream, 0); // Original file size
-			writeField(stream, 0); // Archive file size
-
-			++currFillIn;
+			records.push_back(Record(&entry, static_cast<std::uint32_t>(records.size())));
 		}
-		currFillIn = &fillIn[0];
 
-		// Build data block
+		std::uint64_t tableBytes = 0;
 		for (const Entry &entry : files)
 		{
-			std::uint32_t index = static_cast<std::uint32_t>(stream.tellp());
-			std::uint32_t original_filesize = 0;
-			std::uint32_t archive_filesize = 0;
+			tableBytes += entry.virtual_path.size() + 1 + 3 * sizeof(std::uint32_t);
+		}
 
-			std::ifstream entryFile(entry.real_path, std::ios::in | std::ios::binary | std::ios::ate);
-			if (entryFile.is_open())
+		PerfectHash perfectHash;
+		if (version != Version::V1_0)
+		{
+			if (writePerfectHash)
 			{
-				original_filesize = static_cast<std::uint32_t>(entryFile.tellg());
-				entryFile.seekg(0);
-
-				// Write file data
-				char *filedata = new char[original_filesize];
-				entryFile.read(filedata, original_filesize);
+				// The table is put in the order of the slots, so a slot is also the index of its entry
+				std::vector<std::uint64_t> hashes;
+				hashes.reserve(records.size());
+				for (const Record &record : records)
+				{
+					hashes.push_back(hashPath(record.entry->virtual_path));
+				}
 
-				if (compress(compression, filedata, original_filesize, archive_filesize))
+				std::vector<std::uint32_t> slots;
+				if (buildPerfectHash(hashes, perfectHash.seed, perfectHash.displacements, slots))
 				{
-					stream.write(filedata, archive_filesize);
+					std::vector<Record> ordered(records.size());
+					for (std::size_t i = 0; i < records.size(); ++i)
+					{
+						ordered[slots[i]] = records[i];
+					}
+					records.swap(ordered);
 				}
 				else
 				{
-					original_filesize = 0;
-					archive_filesize  = 0;
+					perfectHash.displacements.clear();
 				}
+			}
+
+			std::uint32_t poolSize = 0;
+			for (const Entry &entry : files)
+			{
+				poolSize += static_cast<std::uint32_t>(entry.virtual_path.size() + 1);
+			}
+			std::uint32_t flags = TABLE_FLAG_HASHES;
+			if (!perfectHash.displacements.empty())
+				flags |= TABLE_FLAG_PERFECT_HASH;
+			if (footer)
+				flags |= TABLE_FLAG_FOOTER;
+
+			writeField(stream, poolSize); // Path pool size
+			writeField(stream, flags); // Flags
+			position += 2 * sizeof(std::uint32_t);
+			tableBytes += 2 * tableSize * sizeof(std::uint32_t) + tableSize * sizeof(std::uint64_t);
+			if (version >= Version::V3_0)
+				tableBytes += 3 * tableSize * sizeof(std::uint32_t); // 64-bit file index and sizes
+			else
+				tableBytes += getTablePadding(tableSize * TABLE_V2_ENTRY_SIZE);
+			if (!perfectHash.displacements.empty())
+				tableBytes += 2 * sizeof(std::uint32_t) + perfectHash.displacements.size() * sizeof(std::uint32_t);
+		}
+
+		// The sizes aren't known until the data is written, so a table in front is
+		// written with zeroes first and filled in with a single seek at the end
+		std::uint64_t tablePos = position;
+		if (!footer)
+		{
+			writeTable(stream, version, records, perfectHash);
+			position += tableBytes;
+		}
 
-				delete[] filedata;
-				filedata = nullptr;
+		// Build data block, in path order whatever the order of the table
+		std::vector<Record*> dataOrder(records.size());
+		for (Record &record : records)
+		{
+			dataOrder[record.order] = &record;
+		}
+		for (Record *record : dataOrder)
+		{
+			const Entry &entry = *record->entry;
+			record->index = position;
+
+			std::ifstream entryFile(entry.real_path, std::ios::in | std::ios::binary | std::ios::ate);
+			if (entryFile.is_open())
+			{
+				std::uint64_t original_filesize = static_cast<std::uint64_t>(entryFile.tellg());
+				std::uint64_t archive_filesize = 0;
+				entryFile.seekg(0);
+
+				// Write file data a chunk at a time, so a file is never held in memory as a whole.
+				// The data can't be taken back once it's written, so a failure fails the build.
+				if (!compress(compression, entryFile, original_filesize, stream, archive_filesize))
+					return false;
+
+				position += archive_filesize;
+				record->original_filesize = original_filesize;
+				record->archive_filesize = archive_filesize;
 
 				entryFile.close();
 			}
+		}
+
+		if (version < Version::V3_0)
+		{
+			// Earlier versions store the file index and sizes in 32 bits
+			const std::uint64_t limit = std::numeric_limits<std::uint32_t>::max();
+			for (const Record &record : records)
+			{
+				if (record.index > limit || record.original_filesize > limit || record.archive_filesize > limit)
+					return false;
+			}
+		}
+
+		if (footer)
+		{
+			// The table follows the data, and the trailer points back at it
+			const std::uint64_t padding = getTablePadding(position);
+			writePadding(stream, padding);
+			position += padding;
+			writeTable(stream, version, records, perfectHash);
+			writeField(stream, position); // Table position
+		}
+		else
+		{
+			stream.seekp(tablePos);
+			writeTable(stream, version, records, perfectHash);
+			stream.seekp(0, std::ios::end);
+		}
 
-			// Fill in header
-			std::uint32_t bpos = static_cast<std::uint32_t>(stream.tellp());
-			std::uint32_t pos = (*currFillIn);
-			stream.seekp(pos);
+		return !stream.fail();
+	}
 
-			writeField(stream, &index);
-			writeField(stream, &original_filesize);
-			writeField(stream, &archive_filesize);
+	void ArchiveBuilder::writeTable(std::ostream &stream, Version version, const std::vector<Record> &records, const PerfectHash &perfectHash) const
+	{
+		if (version == Version::V1_0)
+		{
+			for (const Record &record : records)
+			{
+				const std::string &path = record.entry->virtual_path;
+				stream.write(path.c_str(), sizeof(char)*path.size()+1);
+				writeField(stream, static_cast<std::uint32_t>(record.index)); // File index
+				writeField(stream, static_cast<std::uint32_t>(record.original_filesize)); // Original file size
+				writeField(stream, static_cast<std::uint32_t>(record.archive_filesize)); // Archive file size
+			}
+			return;
+		}
 
-			stream.seekp(bpos);
+		std::uint32_t pathOffset = 0;
+		for (const Record &record : records)
+		{
+			std::uint32_t pathSize = static_cast<std::uint32_t>(record.entry->virtual_path.size());
+			writeField(stream, pathOffset); // Path offset
+			writeField(stream, pathSize); // Path size
+			if (version >= Version::V3_0)
+			{
+				writeField(stream, record.index); // File index
+				writeField(stream, record.original_filesize); // Original file size
+				writeField(stream, record.archive_filesize); // Archive file size
+			}
+			else
+			{
+				writeField(stream, static_cast<std::uint32_t>(record.index)); // File index
+				writeField(stream, static_cast<std::uint32_t>(record.original_filesize)); // Original file size
+				writeField(stream, static_cast<std::uint32_t>(record.archive_filesize)); // Archive file size
+			}
 
-			++currFillIn;
+			pathOffset += pathSize + 1;
 		}
+		if (version < Version::V3_0)
+			writePadding(stream, getTablePadding(records.size() * TABLE_V2_ENTRY_SIZE));
 
-		delete[] fillIn;
-		fillIn = nullptr;
-		currFillIn = nullptr;
+		for (const Record &record : records)
+		{
+			writeField(stream, hashPath(record.entry->virtual_path)); // Path hash
+		}
 
-		return true;
+		if (!perfectHash.displacements.empty())
+		{
+			writeField(stream, static_cast<std::uint32_t>(perfectHash.displacements.size())); // Bucket count
+			writeField(stream, perfectHash.seed); // Seed
+			for (std::uint32_t displacement : perfectHash.displacements)
+			{
+				writeField(stream, displacement); // Displacement
+			}
+		}
+
+		for (const Record &record : records)
+		{
+			const std::string &path = record.entry->virtual_path;
+			stream.write(path.c_str(), sizeof(char)*path.size()+1);
+		}
 	}
 }
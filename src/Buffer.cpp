@@ -0,0 +1,101 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include <ZAP/Buffer.h>
+
+namespace ZAP
+{
+	Buffer::Buffer() : data(nullptr), size(0), resource(nullptr)
+	{
+	}
+	Buffer::Buffer(std::size_t size, MemoryResource *resource) : data(nullptr), size(0), resource(resource != nullptr ? resource : getDefaultResource())
+	{
+		if (size == 0)
+			return;
+
+		data = static_cast<char*>(this->resource->allocate(size));
+		if (data != nullptr)
+			this->size = size;
+	}
+	Buffer::Buffer(char *data, std::size_t size, MemoryResource *resource) : data(data), size(data != nullptr ? size : 0), resource(resource)
+	{
+	}
+	Buffer::Buffer(Buffer &&other) : data(other.data), size(other.size), resource(other.resource)
+	{
+		other.data = nullptr;
+		other.size = 0;
+	}
+	Buffer &Buffer::operator=(Buffer &&other)
+	{
+		if (this != &other)
+		{
+			reset();
+			data = other.data;
+			size = other.size;
+			resource = other.resource;
+			other.data = nullptr;
+			other.size = 0;
+		}
+		return *this;
+	}
+	Buffer::~Buffer()
+	{
+		reset();
+	}
+
+	void Buffer::reset()
+	{
+		if (data != nullptr)
+			resource->deallocate(data, size);
+
+		data = nullptr;
+		size = 0;
+	}
+
+	char *Buffer::release()
+	{
+		char *released = data;
+		data = nullptr;
+		size = 0;
+		return released;
+	}
+
+	char *Buffer::getData()
+	{
+		return data;
+	}
+	const char *Buffer::getData() const
+	{
+		return data;
+	}
+	std::size_t Buffer::getSize() const
+	{
+		return size;
+	}
+	MemoryResource *Buffer::getResource() const
+	{
+		return resource;
+	}
+	bool Buffer::isEmpty() const
+	{
+		return (data == nullptr);
+	}
+}
@@ -22,11 +22,300 @@ THE SOFTWARE.*/
 #include <ZAP/Compression.h>
 #include "Config.h"
 
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <vector>
+
 #ifdef ZAP_COMPRESS_LZ4
 	#include <lz4/lz4.h>
 	#include <lz4/lz4hc.h>
 #endif
 
+namespace
+{
+	// Streamed data is read and compressed this much at a time
+	const std::size_t STREAM_CHUNK_SIZE = 1024 * 1024;
+
+	// Whether a size can be passed to LZ4, which takes sizes as int
+	inline bool fitsInt(std::uint64_t size)
+	{
+		return (size <= static_cast<std::uint64_t>(std::numeric_limits<int>::max()));
+	}
+
+	bool copyStream(std::istream &in, std::uint64_t size, std::ostream &out)
+	{
+		static thread_local std::vector<char> buffer;
+		buffer.resize(STREAM_CHUNK_SIZE);
+
+		while (size > 0)
+		{
+			std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(size, buffer.size()));
+			if (!in.read(buffer.data(), count))
+				return false;
+
+			out.write(buffer.data(), count);
+			size -= count;
+		}
+		return !out.fail();
+	}
+
+#ifdef ZAP_COMPRESS_LZ4
+	const std::size_t LZ4_HISTORY_SIZE = 64 * 1024;
+	const std::uint64_t LZ4_MIN_MATCH = 4;
+
+	// Reads the bytes that follow a literal or match length of 15 in a token
+	inline bool readLength(const unsigned char *&in, const unsigned char *end, std::uint64_t &length)
+	{
+		unsigned char byte;
+		do
+		{
+			if (in == end)
+				return false;
+
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+
+	// Skips the literals of the sequence at in, returns false if the block ends first
+	inline bool skipLiterals(const unsigned char *&in, const unsigned char *end, std::uint64_t &literals)
+	{
+		literals = (*in++ >> 4);
+		if (literals == 15 && !readLength(in, end, literals))
+			return false;
+		if (literals > static_cast<std::uint64_t>(end - in))
+			return false;
+
+		in += literals;
+		return true;
+	}
+
+	// Skips the offset and match length that follow the literals of the sequence with the given token
+	inline bool skipMatch(const unsigned char *&in, const unsigned char *end, unsigned char token)
+	{
+		if (end - in < 2)
+			return false;
+
+		in += 2;
+		std::uint64_t length = (token & 0xF);
+		return (length != 15 || readLength(in, end, length));
+	}
+
+	// Writes the token of a sequence and the rest of its literal length, returns the number of bytes written
+	std::uint64_t writeSequenceStart(std::ostream &out, std::uint64_t literals, unsigned char matchLength)
+	{
+		out.put(static_cast<char>((std::min<std::uint64_t>(literals, 15) << 4) | matchLength));
+		if (literals < 15)
+			return 1;
+
+		char run[1024];
+		std::memset(run, 255, sizeof(run));
+
+		std::uint64_t written = 1;
+		std::uint64_t rest = literals - 15;
+		while (rest >= 255)
+		{
+			std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(rest / 255, sizeof(run)));
+			out.write(run, count);
+			written += count;
+			rest -= count * 255;
+		}
+		out.put(static_cast<char>(rest));
+		return written + 1;
+	}
+
+	// Copies data that was read before back out of the input stream, and returns to where it was
+	bool copyFromInput(std::istream &in, std::istream::pos_type from, std::uint64_t size, char *buffer, std::size_t capacity, std::ostream &out)
+	{
+		if (size == 0)
+			return true;
+
+		std::istream::pos_type resume = in.tellg();
+		if (!in.seekg(from))
+			return false;
+
+		while (size > 0)
+		{
+			std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(size, capacity));
+			if (!in.read(buffer, count))
+				return false;
+
+			out.write(buffer, count);
+			size -= count;
+		}
+		return static_cast<bool>(in.seekg(resume));
+	}
+
+	// Every chunk is compressed to an LZ4 block whose matches can reach into the chunks before it, like
+	// LZ4's own streaming. The blocks are joined into one: every block ends with a sequence of literals only,
+	// which is held back and becomes part of the literals of the first sequence of the next block.
+	// The held back literals are copied from the input when that sequence is written,
+	// so they don't need to be kept in memory, however many chunks didn't compress at all.
+	bool compressStream(std::istream &in, std::uint64_t in_size, std::ostream &out, std::uint64_t &out_size)
+	{
+		static thread_local std::unique_ptr<LZ4_streamHC_t, int(*)(LZ4_streamHC_t*)> state(LZ4_createStreamHC(), LZ4_freeStreamHC);
+		static thread_local std::vector<char> input, output, history;
+		if (state == nullptr)
+			return false;
+
+		LZ4_resetStreamHC_fast(state.get(), LZ4HC_CLEVEL_DEFAULT);
+		input.resize(STREAM_CHUNK_SIZE);
+		output.resize(LZ4_COMPRESSBOUND(STREAM_CHUNK_SIZE));
+		history.resize(LZ4_HISTORY_SIZE);
+
+		const std::istream::pos_type begin = in.tellg();
+		std::uint64_t heldPos = 0, heldSize = 0;
+		std::uint64_t read = 0;
+		out_size = 0;
+
+		while (read < in_size)
+		{
+			std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(in_size - read, input.size()));
+			if (!in.read(input.data(), count))
+				return false;
+			read += count;
+
+			int compressed = LZ4_compress_HC_continue(state.get(), input.data(), output.data(), static_cast<int>(count), static_cast<int>(output.size()));
+			if (compressed <= 0)
+				return false;
+
+			// The input buffer is reused for the next chunk, so the history matches refer to is moved out of it
+			LZ4_saveDictHC(state.get(), history.data(), static_cast<int>(history.size()));
+
+			const unsigned char *block = reinterpret_cast<const unsigned char*>(output.data());
+			const unsigned char *end = block + compressed;
+			const unsigned char *cursor = block;
+
+			std::uint64_t literals;
+			if (!skipLiterals(cursor, end, literals))
+				return false;
+			if (cursor == end)
+			{
+				// Nothing matched, so the whole chunk is held back
+				if (heldSize == 0)
+					heldPos = read - count;
+				heldSize += literals;
+				continue;
+			}
+
+			const unsigned char token = block[0];
+			const unsigned char *firstLiterals = cursor - literals;
+			if (!skipMatch(cursor, end, token))
+				return false;
+
+			// The first sequence takes the held back literals in front of its own
+			out_size += writeSequenceStart(out, heldSize + literals, token & 0xF);
+			if (!copyFromInput(in, begin + static_cast<std::streamoff>(heldPos), heldSize, input.data(), input.size(), out))
+				return false;
+			out.write(reinterpret_cast<const char*>(firstLiterals), cursor - firstLiterals);
+			out_size += heldSize + static_cast<std::uint64_t>(cursor - firstLiterals);
+
+			// The sequences in between are copied as they are, up to the last one, which is held back
+			const unsigned char *middle = cursor;
+			const unsigned char *last;
+			for (;;)
+			{
+				if (cursor == end)
+					return false;
+
+				last = cursor;
+				if (!skipLiterals(cursor, end, literals))
+					return false;
+				if (cursor == end)
+					break;
+				if (!skipMatch(cursor, end, *last))
+					return false;
+			}
+			out.write(reinterpret_cast<const char*>(middle), last - middle);
+			out_size += static_cast<std::uint64_t>(last - middle);
+
+			heldPos = read - literals;
+			heldSize = literals;
+		}
+
+		// The joined block ends with a sequence of literals only, like every LZ4 block
+		out_size += writeSequenceStart(out, heldSize, 0);
+		if (!copyFromInput(in, begin + static_cast<std::streamoff>(heldPos), heldSize, input.data(), input.size(), out))
+			return false;
+		out_size += heldSize;
+
+		return !out.fail();
+	}
+
+	// Decodes an LZ4 block without the library, which takes sizes as int and needs the whole block.
+	// With prefix set, decoding stops after out_size bytes and in_data can be cut short anywhere,
+	// also within a length, otherwise the block has to decompress to exactly out_size bytes.
+	bool decodeBlock(const char *in_data, std::uint64_t in_size, char *out_data, std::uint64_t out_size, bool prefix)
+	{
+		const unsigned char *in = reinterpret_cast<const unsigned char*>(in_data);
+		const unsigned char *inEnd = in + in_size;
+		char *out = out_data;
+		char *outEnd = out_data + out_size;
+
+		while (in != inEnd)
+		{
+			const unsigned char token = *in++;
+			std::uint64_t literals = (token >> 4);
+			if (literals == 15 && !readLength(in, inEnd, literals))
+				return false;
+
+			std::uint64_t space = static_cast<std::uint64_t>(outEnd - out);
+			if (literals > space && !prefix)
+				return false;
+
+			std::uint64_t count = std::min(literals, space);
+			if (count > static_cast<std::uint64_t>(inEnd - in))
+				return false;
+
+			std::memcpy(out, in, static_cast<std::size_t>(count));
+			in += count;
+			out += count;
+			if (out == outEnd && (prefix || in == inEnd))
+				return true;
+			if (in == inEnd)
+				return false;
+
+			if (inEnd - in < 2)
+				return false;
+
+			const std::size_t offset = in[0] | (static_cast<std::size_t>(in[1]) << 8);
+			in += 2;
+			if (offset == 0 || offset > static_cast<std::size_t>(out - out_data))
+				return false;
+
+			std::uint64_t match = (token & 0xF);
+			if (match == 15 && !readLength(in, inEnd, match))
+				return false;
+			match += LZ4_MIN_MATCH;
+
+			space = static_cast<std::uint64_t>(outEnd - out);
+			if (match > space && !prefix)
+				return false;
+
+			// Overlapping matches repeat the last offset bytes, and every copy doubles how much can be copied at once
+			const char *source = out - offset;
+			for (std::uint64_t left = std::min(match, space); left > 0;)
+			{
+				std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(left, static_cast<std::uint64_t>(out - source)));
+				std::memcpy(out, source, chunk);
+				out += chunk;
+				left -= chunk;
+			}
+			if (out == outEnd && prefix)
+				return true;
+		}
+
+		return false;
+	}
+#endif
+}
+
 namespace ZAP
 {
 	bool supportsCompression(Compression compression)
@@ -41,12 +330,16 @@ namespace ZAP
 		}
 	}
 
-	bool compress(Compression compression, char *&data, std::uint32_t in_size, std::uint32_t &out_size)
+	bool compress(Compression compression, char *&data, std::uint64_t in_size, std::uint64_t &out_size, MemoryResource *resource)
 	{
 		if (data == nullptr)
 		{
 			return false;
 		}
+		if (resource == nullptr)
+		{
+			resource = getDefaultResource();
+		}
 
 		switch (compression)
 		{
@@ -58,20 +351,28 @@ namespace ZAP
 			#ifdef ZAP_COMPRESS_LZ4
 			case Compression::LZ4:
 			{
-				int out_capacity = LZ4_compressBound(in_size);
-				char *out_data = new char[out_capacity];
-				out_size = LZ4_compress_HC(data, out_data, in_size, out_capacity, LZ4HC_CLEVEL_DEFAULT);
-				if (out_size > 0)
-				{
-					delete[] data;
-					data = out_data;
-					return true;
-				}
-				else
-				{
-					delete[] out_data;
+				if (in_size > LZ4_MAX_INPUT_SIZE)
 					return false;
-				}
+
+				// The compressed size isn't known up front, so compress to scratch space and allocate exactly that much
+				const std::size_t scratchSize = static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(in_size)));
+				std::unique_ptr<char[], ResourceDeleter> scratch(static_cast<char*>(resource->allocate(scratchSize)), ResourceDeleter(resource, scratchSize));
+				if (scratch == nullptr)
+					return false;
+
+				int compressed = LZ4_compress_HC(data, scratch.get(), static_cast<int>(in_size), static_cast<int>(scratchSize), LZ4HC_CLEVEL_DEFAULT);
+				if (compressed <= 0)
+					return false;
+
+				char *out_data = static_cast<char*>(resource->allocate(compressed));
+				if (out_data == nullptr)
+					return false;
+
+				std::memcpy(out_data, scratch.get(), compressed);
+				resource->deallocate(data, static_cast<std::size_t>(in_size));
+				data = out_data;
+				out_size = static_cast<std::uint64_t>(compressed);
+				return true;
 			}
 			#endif
 			default:
@@ -81,8 +382,35 @@ namespace ZAP
 		}
 	}
 
-	bool decompress(Compression compression, char *&data, std::uint32_t in_size, std::uint32_t out_size)
+	bool compress(Compression compression, std::istream &in, std::uint64_t in_size, std::ostream &out, std::uint64_t &out_size)
 	{
+		switch (compression)
+		{
+			case Compression::NONE:
+			{
+				out_size = in_size;
+				return copyStream(in, in_size, out);
+			}
+			#ifdef ZAP_COMPRESS_LZ4
+			case Compression::LZ4:
+			{
+				return compressStream(in, in_size, out, out_size);
+			}
+			#endif
+			default:
+			{
+				return false;
+			}
+		}
+	}
+
+	bool decompress(Compression compression, char *&data, std::uint64_t in_size, std::uint64_t out_size, MemoryResource *resource)
+	{
+		if (resource == nullptr)
+		{
+			resource = getDefaultResource();
+		}
+
 		switch (compression)
 		{
 			case Compression::NONE:
@@ -92,16 +420,19 @@ namespace ZAP
 			#ifdef ZAP_COMPRESS_LZ4
 			case Compression::LZ4:
 			{
-				char *out_data = new char[out_size];
-				if (LZ4_decompress_safe(data, out_data, in_size, out_size) > 0)
+				char *out_data = static_cast<char*>(resource->allocate(static_cast<std::size_t>(out_size)));
+				if (out_data == nullptr)
+					return false;
+
+				if (decompress(compression, data, in_size, out_data, out_size))
 				{
-					delete[] data;
+					resource->deallocate(data, static_cast<std::size_t>(in_size));
 					data = out_data;
 					return true;
 				}
 				else
 				{
-					delete[] out_data;
+					resource->deallocate(out_data, static_cast<std::size_t>(out_size));
 					return false;
 				}
 			}
@@ -112,4 +443,88 @@ namespace ZAP
 			}
 		}
 	}
+
+	bool decompress(Compression compression, const char *in_data, std::uint64_t in_size, char *out_data, std::uint64_t out_size)
+	{
+		if (in_data == nullptr || out_data == nullptr)
+		{
+			return false;
+		}
+
+		switch (compression)
+		{
+			case Compression::NONE:
+			{
+				if (in_size != out_size)
+					return false;
+
+				std::memcpy(out_data, in_data, static_cast<std::size_t>(out_size));
+				return true;
+			}
+			#ifdef ZAP_COMPRESS_LZ4
+			case Compression::LZ4:
+			{
+				if (!fitsInt(in_size) || !fitsInt(out_size))
+					return decodeBlock(in_data, in_size, out_data, out_size, false);
+
+				return (LZ4_decompress_safe(in_data, out_data, static_cast<int>(in_size), static_cast<int>(out_size)) == static_cast<int>(out_size));
+			}
+			#endif
+			default:
+			{
+				return false;
+			}
+		}
+	}
+
+	std::uint64_t getPrefixInputBound(Compression compression, std::uint64_t out_size)
+	{
+		switch (compression)
+		{
+			#ifdef ZAP_COMPRESS_LZ4
+			case Compression::LZ4:
+			{
+				// Every decompressed byte costs at most a literal byte, plus the token and length overhead.
+				// A run of literals longer than the prefix has a longer length, which needs the rest of the data.
+				return out_size + out_size / 255 + 16;
+			}
+			#endif
+			default:
+			{
+				return out_size;
+			}
+		}
+	}
+
+	bool decompressPrefix(Compression compression, const char *in_data, std::uint64_t in_size, char *out_data, std::uint64_t out_size)
+	{
+		if (in_data == nullptr || out_data == nullptr)
+		{
+			return false;
+		}
+
+		switch (compression)
+		{
+			case Compression::NONE:
+			{
+				if (in_size < out_size)
+					return false;
+
+				std::memcpy(out_data, in_data, static_cast<std::size_t>(out_size));
+				return true;
+			}
+			#ifdef ZAP_COMPRESS_LZ4
+			case Compression::LZ4:
+			{
+				// LZ4_decompress_safe_partial() needs the whole block, cut short within the length of a run
+				// of literals it returns the bytes of the length as data
+				return decodeBlock(in_data, in_size, out_data, out_size, true);
+			}
+			#endif
+			default:
+			{
+				return false;
+			}
+		}
+	}
 }
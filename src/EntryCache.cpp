@@ -0,0 +1,216 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include <ZAP/EntryCache.h>
+
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	const std::size_t SHARD_COUNT = 16;
+
+	// With SEGMENTED_LRU, this part of the budget is for protected entries
+	const std::size_t PROTECTED_PERCENT = 80;
+}
+
+namespace ZAP
+{
+	EntryCache::EntryCache(std::size_t budget, CachePolicy policy) : budget(budget), policy(policy), totalSize(0), totalProtectedSize(0), clock(0)
+	{
+		shards.reserve(SHARD_COUNT);
+		for (std::size_t i = 0; i < SHARD_COUNT; ++i)
+		{
+			shards.emplace_back(new Shard());
+		}
+	}
+
+	bool EntryCache::find(std::size_t key, std::shared_ptr<const char> &data, std::size_t &size)
+	{
+		Shard &shard = getShard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto found = shard.nodes.find(key);
+		if (found == shard.nodes.end())
+		{
+			++shard.misses;
+			return false;
+		}
+		++shard.hits;
+
+		NodeList::iterator node = found->second;
+		node->lastUse = ++clock;
+		if (node->isProtected)
+		{
+			shard.protectedNodes.splice(shard.protectedNodes.begin(), shard.protectedNodes, node);
+		}
+		else if (policy == CachePolicy::SEGMENTED_LRU)
+		{
+			// Used again, so it moves to the protected segment, and the oldest protected entries of this shard move back
+			node->isProtected = true;
+			shard.protectedSize += node->size;
+			totalProtectedSize += node->size;
+			shard.protectedNodes.splice(shard.protectedNodes.begin(), shard.probationary, node);
+
+			const std::size_t protectedBudget = budget / 100 * PROTECTED_PERCENT;
+			while (totalProtectedSize > protectedBudget && std::prev(shard.protectedNodes.end()) != node)
+			{
+				NodeList::iterator oldest = std::prev(shard.protectedNodes.end());
+				oldest->isProtected = false;
+				shard.protectedSize -= oldest->size;
+				totalProtectedSize -= oldest->size;
+				shard.probationary.splice(shard.probationary.begin(), shard.protectedNodes, oldest);
+			}
+		}
+		else
+		{
+			shard.probationary.splice(shard.probationary.begin(), shard.probationary, node);
+		}
+
+		data = node->data;
+		size = node->size;
+		return true;
+	}
+
+	void EntryCache::insert(std::size_t key, std::shared_ptr<const char> data, std::size_t size)
+	{
+		if (size > budget)
+			return;
+
+		Shard &shard = getShard(key);
+		std::unique_lock<std::mutex> lock(shard.mutex);
+
+		// Another thread may have loaded the same entry in the meantime
+		if (shard.nodes.find(key) != shard.nodes.end())
+			return;
+
+		// Shards are locked one at a time, so evicting from all of them can't deadlock with other inserts
+		lock.unlock();
+		evict(size);
+		lock.lock();
+
+		if (shard.nodes.find(key) != shard.nodes.end())
+			return;
+
+		Node node = { key, std::move(data), size, ++clock, false };
+		shard.probationary.push_front(std::move(node));
+		shard.nodes[key] = shard.probationary.begin();
+		shard.size += size;
+		totalSize += size;
+	}
+
+	void EntryCache::clear()
+	{
+		for (std::unique_ptr<Shard> &shard : shards)
+		{
+			std::lock_guard<std::mutex> lock(shard->mutex);
+			shard->probationary.clear();
+			shard->protectedNodes.clear();
+			shard->nodes.clear();
+			totalSize -= shard->size;
+			totalProtectedSize -= shard->protectedSize;
+			shard->size = 0;
+			shard->protectedSize = 0;
+		}
+	}
+
+	CacheStats EntryCache::getStats() const
+	{
+		CacheStats stats = {};
+		stats.budget = budget;
+
+		for (const std::unique_ptr<Shard> &shard : shards)
+		{
+			std::lock_guard<std::mutex> lock(shard->mutex);
+			stats.hits += shard->hits;
+			stats.misses += shard->misses;
+			stats.evictions += shard->evictions;
+			stats.size += shard->size;
+		}
+		return stats;
+	}
+
+	CachePolicy EntryCache::getPolicy() const
+	{
+		return policy;
+	}
+
+	EntryCache::Shard &EntryCache::getShard(std::size_t key)
+	{
+		// Neighbouring entries are usually loaded together, so they are spread over the shards
+		return *shards[key % SHARD_COUNT];
+	}
+
+	void EntryCache::evict(std::size_t needed)
+	{
+		while (totalSize + needed > budget)
+		{
+			// Find the shard whose next entry to evict was used longest ago. Probationary entries
+			// go first, protected ones only when no shard has a probationary entry left.
+			Shard *victim = nullptr;
+			bool victimProtected = true;
+			std::uint64_t victimUse = 0;
+			for (std::unique_ptr<Shard> &shard : shards)
+			{
+				std::lock_guard<std::mutex> lock(shard->mutex);
+				const NodeList &list = (!shard->probationary.empty() ? shard->probationary : shard->protectedNodes);
+				if (list.empty())
+					continue;
+
+				const Node &oldest = list.back();
+				if (victim == nullptr || (!oldest.isProtected && victimProtected) ||
+					(oldest.isProtected == victimProtected && oldest.lastUse < victimUse))
+				{
+					victim = shard.get();
+					victimProtected = oldest.isProtected;
+					victimUse = oldest.lastUse;
+				}
+			}
+
+			if (victim == nullptr)
+				return;
+
+			// Other threads may have changed the shard since, its oldest entry is still a fair choice
+			std::lock_guard<std::mutex> lock(victim->mutex);
+			evictOldest(*victim);
+		}
+	}
+
+	void EntryCache::evictOldest(Shard &shard)
+	{
+		NodeList &list = (!shard.probationary.empty() ? shard.probationary : shard.protectedNodes);
+		if (list.empty())
+			return;
+
+		NodeList::iterator oldest = std::prev(list.end());
+		if (oldest->isProtected)
+		{
+			shard.protectedSize -= oldest->size;
+			totalProtectedSize -= oldest->size;
+		}
+		shard.size -= oldest->size;
+		totalSize -= oldest->size;
+		++shard.evictions;
+
+		shard.nodes.erase(oldest->key);
+		list.erase(oldest);
+	}
+}
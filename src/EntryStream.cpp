@@ -0,0 +1,534 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include <ZAP/EntryStream.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Matches reach at most this far back
+	const std::size_t HISTORY_SIZE = ZAP::EntryReader::WINDOW_SIZE / 2;
+
+	const std::size_t MIN_MATCH = 4;
+}
+
+namespace ZAP
+{
+	const std::size_t EntryReader::INPUT_SIZE;
+	const std::size_t EntryReader::WINDOW_SIZE;
+
+	EntryReader::EntryReader() : archive(nullptr), entry(nullptr), compression(Compression::NONE), state(State::DONE)
+	{
+		close();
+	}
+	EntryReader::EntryReader(const Archive &archive, const Archive::Entry *entry) : EntryReader()
+	{
+		open(archive, entry);
+	}
+
+	bool EntryReader::open(const Archive &archive, const Archive::Entry *entry)
+	{
+		close();
+
+		if (entry == nullptr || !archive.isOpen() || !archive.isSupportedCompression())
+			return false;
+
+		this->archive = &archive;
+		this->entry = entry;
+		compression = archive.getCompression();
+		state = State::TOKEN;
+
+		if (compression == Compression::NONE && entry->compressed_size != entry->decompressed_size)
+		{
+			fail();
+			return true;
+		}
+
+		const char *data = archive.getMemory(entry);
+		if (data != nullptr)
+		{
+			memory = archive.memory;
+			input = data;
+			inputEnd = entry->compressed_size;
+			compressedRead = entry->compressed_size;
+		}
+		else if (archive.memory)
+		{
+			fail();
+			return true;
+		}
+		else
+		{
+			// Uncompressed files are read straight into the window, without an input buffer
+			if (compression != Compression::NONE)
+			{
+				MemoryResource *resource = archive.getMemoryResource();
+				inputBuffer = std::unique_ptr<char[], ResourceDeleter>(static_cast<char*>(resource->allocate(INPUT_SIZE)), ResourceDeleter(resource, INPUT_SIZE));
+				if (inputBuffer == nullptr)
+				{
+					fail();
+					return true;
+				}
+				input = inputBuffer.get();
+			}
+		}
+
+		if (compression != Compression::NONE || data == nullptr)
+		{
+			MemoryResource *resource = archive.getMemoryResource();
+			window = std::unique_ptr<char[], ResourceDeleter>(static_cast<char*>(resource->allocate(WINDOW_SIZE)), ResourceDeleter(resource, WINDOW_SIZE));
+			if (window == nullptr)
+			{
+				fail();
+				return true;
+			}
+			output = window.get();
+		}
+
+		return true;
+	}
+
+	void EntryReader::close()
+	{
+		archive = nullptr;
+		entry = nullptr;
+		state = State::DONE;
+
+		memory.reset();
+		inputBuffer.reset();
+		input = nullptr;
+		inputPos = 0;
+		inputEnd = 0;
+		compressedRead = 0;
+
+		window.reset();
+		output = nullptr;
+		outputPos = 0;
+		outputEnd = 0;
+		decompressedRead = 0;
+		decompressed = 0;
+
+		literalLength = 0;
+		matchLength = 0;
+		matchOffset = 0;
+		offsetBytes = 0;
+	}
+
+	bool EntryReader::isOpen() const
+	{
+		return (entry != nullptr);
+	}
+
+	std::size_t EntryReader::read(char *data, std::size_t size)
+	{
+		std::size_t total = 0;
+		while (total < size && fill())
+		{
+			std::size_t count = std::min(size - total, outputEnd - outputPos);
+			std::memcpy(data + total, output + outputPos, count);
+			outputPos += count;
+			decompressedRead += count;
+			total += count;
+		}
+		return total;
+	}
+
+	std::size_t EntryReader::readChunk(const char *&data)
+	{
+		if (!fill())
+			return 0;
+
+		std::size_t count = outputEnd - outputPos;
+		data = output + outputPos;
+		outputPos = outputEnd;
+		decompressedRead += count;
+		return count;
+	}
+
+	bool EntryReader::isEnd() const
+	{
+		return (entry == nullptr || decompressedRead == entry->decompressed_size);
+	}
+
+	bool EntryReader::hasFailed() const
+	{
+		return (state == State::FAILED);
+	}
+
+	std::uint64_t EntryReader::getPosition() const
+	{
+		return decompressedRead;
+	}
+
+	std::uint64_t EntryReader::getSize() const
+	{
+		return (entry != nullptr ? entry->decompressed_size : 0);
+	}
+
+	bool EntryReader::fill()
+	{
+		if (outputPos < outputEnd)
+			return true;
+		if (entry == nullptr || state == State::FAILED || isEnd())
+			return false;
+
+		if (compression == Compression::NONE)
+		{
+			std::uint64_t left = entry->decompressed_size - decompressedRead;
+			if (window == nullptr)
+			{
+				// The whole file is already in memory
+				output = input + decompressedRead;
+				outputPos = 0;
+				outputEnd = static_cast<std::size_t>(left);
+				return true;
+			}
+
+			std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(left, WINDOW_SIZE));
+			if (!archive->read(entry->index + decompressedRead, window.get(), count))
+			{
+				fail();
+				return false;
+			}
+			outputPos = 0;
+			outputEnd = count;
+			return true;
+		}
+
+		// Everything has been read, so all but the history for matches can go
+		if (outputEnd == WINDOW_SIZE)
+		{
+			std::memmove(window.get(), window.get() + WINDOW_SIZE - HISTORY_SIZE, HISTORY_SIZE);
+			outputPos = HISTORY_SIZE;
+			outputEnd = HISTORY_SIZE;
+		}
+
+		decode();
+		if (state == State::DONE && decompressed != entry->decompressed_size)
+			fail();
+
+		return (outputPos < outputEnd);
+	}
+
+	bool EntryReader::fillInput()
+	{
+		if (compressedRead == entry->compressed_size)
+			return false;
+
+		std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(entry->compressed_size - compressedRead, INPUT_SIZE));
+		if (!archive->read(entry->index + compressedRead, inputBuffer.get(), count))
+		{
+			fail();
+			return false;
+		}
+
+		compressedRead += count;
+		inputPos = 0;
+		inputEnd = count;
+		return true;
+	}
+
+	bool EntryReader::nextByte(std::uint8_t &byte)
+	{
+		if (inputPos == inputEnd && !fillInput())
+		{
+			fail();
+			return false;
+		}
+
+		byte = static_cast<std::uint8_t>(input[inputPos++]);
+		return true;
+	}
+
+	// Decodes the LZ4 block a piece at a time, until the window is full or the block ends.
+	// Each field can be split over two input windows, so every state picks up where the last left off.
+	void EntryReader::decode()
+	{
+		char *out = window.get();
+		std::uint8_t byte;
+
+		while (outputEnd < WINDOW_SIZE)
+		{
+			switch (state)
+			{
+			case State::TOKEN:
+				decodeSequences();
+				if (outputEnd == WINDOW_SIZE || state != State::TOKEN)
+					break;
+
+				if (!nextByte(byte))
+					return;
+
+				literalLength = (byte >> 4);
+				matchLength = (byte & 0xF);
+				state = (literalLength == 15 ? State::LITERAL_LENGTH : State::LITERALS);
+				break;
+
+			case State::LITERAL_LENGTH:
+				if (!nextByte(byte))
+					return;
+
+				literalLength += byte;
+				if (byte != 255)
+					state = State::LITERALS;
+				break;
+
+			case State::LITERALS:
+			{
+				if (literalLength > entry->decompressed_size - decompressed)
+				{
+					fail();
+					return;
+				}
+
+				if (literalLength > 0 && inputPos == inputEnd && !fillInput())
+				{
+					fail();
+					return;
+				}
+
+				std::size_t count = std::min(std::min(literalLength, inputEnd - inputPos), WINDOW_SIZE - outputEnd);
+				std::memcpy(out + outputEnd, input + inputPos, count);
+				inputPos += count;
+				outputEnd += count;
+				decompressed += count;
+				literalLength -= count;
+
+				if (literalLength == 0)
+				{
+					// The last sequence only has literals
+					if (inputPos == inputEnd && compressedRead == entry->compressed_size)
+					{
+						state = State::DONE;
+						return;
+					}
+
+					matchOffset = 0;
+					offsetBytes = 0;
+					state = State::OFFSET;
+				}
+				break;
+			}
+
+			case State::OFFSET:
+				if (!nextByte(byte))
+					return;
+
+				matchOffset |= static_cast<std::size_t>(byte) << (8 * offsetBytes);
+				if (++offsetBytes == 2)
+				{
+					if (matchOffset == 0 || matchOffset > outputEnd)
+					{
+						fail();
+						return;
+					}
+					state = (matchLength == 15 ? State::MATCH_LENGTH : State::MATCH);
+					matchLength += MIN_MATCH;
+				}
+				break;
+
+			case State::MATCH_LENGTH:
+				if (!nextByte(byte))
+					return;
+
+				matchLength += byte;
+				if (byte != 255)
+					state = State::MATCH;
+				break;
+
+			case State::MATCH:
+			{
+				if (matchLength > entry->decompressed_size - decompressed)
+				{
+					fail();
+					return;
+				}
+
+				// The window may have moved since the offset was checked, but it always keeps enough history
+				std::size_t count = std::min(matchLength, WINDOW_SIZE - outputEnd);
+				const char *source = out + outputEnd - matchOffset;
+				char *dest = out + outputEnd;
+
+				// Overlapping matches repeat the last matchOffset bytes, and every copy doubles how much can be copied at once
+				for (std::size_t left = count; left > 0;)
+				{
+					std::size_t chunk = std::min(left, static_cast<std::size_t>(dest - source));
+					std::memcpy(dest, source, chunk);
+					dest += chunk;
+					left -= chunk;
+				}
+
+				outputEnd += count;
+				decompressed += count;
+				matchLength -= count;
+
+				if (matchLength == 0)
+					state = State::TOKEN;
+				break;
+			}
+
+			case State::DONE:
+			case State::FAILED:
+				return;
+			}
+		}
+	}
+
+	// Sequences that lie wholly in the input window, and whose output fits in the window, are decoded
+	// in one go, which saves going through every state for every sequence. Anything else is left to decode().
+	void EntryReader::decodeSequences()
+	{
+		char *out = window.get();
+
+		for (;;)
+		{
+			const char *in = input + inputPos;
+			const char *inEnd = input + inputEnd;
+			const std::size_t space = WINDOW_SIZE - outputEnd;
+
+			if (in == inEnd)
+				return;
+
+			const std::uint8_t token = static_cast<std::uint8_t>(*in++);
+			std::size_t literals = (token >> 4);
+			std::size_t match = (token & 0xF);
+
+			if (literals == 15 && !readLength(in, inEnd, literals))
+				return;
+
+			// There have to be input bytes left after the literals and offset, or this could be the last sequence
+			if (literals > space || static_cast<std::size_t>(inEnd - in) < literals + 3)
+				return;
+
+			const char *literalData = in;
+			in += literals;
+
+			const std::size_t offset = static_cast<std::uint8_t>(in[0]) | (static_cast<std::size_t>(static_cast<std::uint8_t>(in[1])) << 8);
+			in += 2;
+
+			if (match == 15 && !readLength(in, inEnd, match))
+				return;
+			match += MIN_MATCH;
+
+			if (literals + match > space)
+				return;
+
+			if (literals + match > entry->decompressed_size - decompressed || offset == 0 || offset > outputEnd + literals)
+			{
+				fail();
+				return;
+			}
+
+			std::memcpy(out + outputEnd, literalData, literals);
+
+			char *dest = out + outputEnd + literals;
+			const char *source = dest - offset;
+			for (std::size_t left = match; left > 0;)
+			{
+				std::size_t chunk = std::min(left, static_cast<std::size_t>(dest - source));
+				std::memcpy(dest, source, chunk);
+				dest += chunk;
+				left -= chunk;
+			}
+
+			inputPos = static_cast<std::size_t>(in - input);
+			outputEnd += literals + match;
+			decompressed += literals + match;
+		}
+	}
+
+	bool EntryReader::readLength(const char *&in, const char *end, std::size_t &length)
+	{
+		std::uint8_t byte;
+		do
+		{
+			if (in == end)
+				return false;
+
+			byte = static_cast<std::uint8_t>(*in++);
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+
+	void EntryReader::fail()
+	{
+		state = State::FAILED;
+		outputPos = outputEnd;
+	}
+
+	EntryStreamBuffer::EntryStreamBuffer(const Archive &archive, const Archive::Entry *entry) : reader(archive, entry)
+	{
+	}
+
+	const EntryReader &EntryStreamBuffer::getReader() const
+	{
+		return reader;
+	}
+
+	EntryStreamBuffer::int_type EntryStreamBuffer::underflow()
+	{
+		if (gptr() < egptr())
+			return traits_type::to_int_type(*gptr());
+
+		const char *data;
+		std::size_t count = reader.readChunk(data);
+		if (count == 0)
+			return traits_type::eof();
+
+		// The get area is never written to, we only need a mutable pointer to satisfy setg
+		char *begin = const_cast<char*>(data);
+		setg(begin, begin, begin + count);
+		return traits_type::to_int_type(*gptr());
+	}
+
+	std::streamsize EntryStreamBuffer::showmanyc()
+	{
+		return static_cast<std::streamsize>(reader.getSize() - reader.getPosition());
+	}
+
+	EntryStreamBuffer::pos_type EntryStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+	{
+		// Only tellg() is supported, the position is whatever has been read minus what is left in the get area
+		if ((which & std::ios_base::in) == 0 || off != 0 || dir != std::ios_base::cur)
+			return pos_type(off_type(-1));
+
+		return pos_type(static_cast<off_type>(reader.getPosition()) - (egptr() - gptr()));
+	}
+
+	EntryStream::EntryStream(const Archive &archive, const Archive::Entry *entry) : std::istream(nullptr), buffer(archive, entry)
+	{
+		rdbuf(&buffer);
+		if (!buffer.getReader().isOpen())
+			setstate(std::ios_base::failbit);
+	}
+	EntryStream::EntryStream(const Archive &archive, const std::string &virtual_path) : EntryStream(archive, archive.getEntry(virtual_path))
+	{
+	}
+
+	bool EntryStream::hasFailed() const
+	{
+		return buffer.getReader().hasFailed();
+	}
+}
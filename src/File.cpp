@@ -0,0 +1,495 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "File.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/uio.h>
+	#include <unistd.h>
+#endif
+
+#ifdef ZAP_IO_URING
+	#include <liburing.h>
+#endif
+
+#ifndef _WIN32
+namespace
+{
+	// Number of buffers handed to a single preadv, well below IOV_MAX everywhere
+	const std::size_t IOV_BATCH = 64;
+}
+#endif
+
+#ifdef ZAP_IO_URING
+namespace
+{
+	// Larger reads are done synchronously, the length of an io_uring read is 32 bits
+	const std::size_t MAX_RING_READ = 0x40000000;
+
+	// Every thread gets its own ring, so batches from different threads never contend.
+	// A ring that failed to set up or broke isn't tried again, the thread reads synchronously from then on.
+	struct Ring
+	{
+		Ring() : depth(0), ready(false), broken(false) {}
+		~Ring()
+		{
+			exit();
+		}
+
+		bool init(unsigned depth)
+		{
+			if (broken)
+				return false;
+			if (ready && this->depth == depth)
+				return true;
+
+			exit();
+			ready = (io_uring_queue_init(depth, &ring, 0) == 0);
+			broken = !ready;
+			this->depth = (ready ? depth : 0);
+			return ready;
+		}
+		void exit()
+		{
+			if (ready)
+				io_uring_queue_exit(&ring);
+			ready = false;
+			depth = 0;
+		}
+
+		struct io_uring ring;
+		unsigned depth;
+		bool ready;
+		bool broken;
+	};
+}
+#endif
+
+namespace ZAP
+{
+	const unsigned File::MAX_QUEUE_DEPTH;
+
+#ifdef _WIN32
+	File::File() : handle(INVALID_HANDLE_VALUE), size(0)
+	{
+	}
+#else
+	File::File() : fd(-1), size(0)
+	{
+	}
+#endif
+	File::~File()
+	{
+		close();
+	}
+
+	bool File::open(const std::string &filename)
+	{
+		close();
+
+	#ifdef _WIN32
+		handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(handle, &fileSize))
+		{
+			close();
+			return false;
+		}
+		size = static_cast<std::uint64_t>(fileSize.QuadPart);
+	#else
+		fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat sb;
+		if (fstat(fd, &sb) != 0)
+		{
+			close();
+			return false;
+		}
+		size = static_cast<std::uint64_t>(sb.st_size);
+	#endif
+		return true;
+	}
+
+	void File::close()
+	{
+	#ifdef _WIN32
+		if (handle != INVALID_HANDLE_VALUE)
+			CloseHandle(handle);
+		handle = INVALID_HANDLE_VALUE;
+	#else
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+	#endif
+		size = 0;
+	}
+
+	bool File::isOpen() const
+	{
+	#ifdef _WIN32
+		return (handle != INVALID_HANDLE_VALUE);
+	#else
+		return (fd >= 0);
+	#endif
+	}
+
+	std::uint64_t File::getSize() const
+	{
+		return size;
+	}
+
+	bool File::read(std::uint64_t offset, char *data, std::size_t count) const
+	{
+		if (offset > size || count > size - offset)
+			return false;
+
+		// A single read can return less than asked for, so keep going until everything is read
+		while (count > 0)
+		{
+		#ifdef _WIN32
+			DWORD chunk = (count > 0x80000000u ? 0x80000000u : static_cast<DWORD>(count));
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+			DWORD bytesRead = 0;
+			if (!ReadFile(handle, data, chunk, &bytesRead, &overlapped) || bytesRead == 0)
+				return false;
+		#else
+			ssize_t bytesRead = pread(fd, data, count, static_cast<off_t>(offset));
+			if (bytesRead < 0 && errno == EINTR)
+				continue;
+			if (bytesRead <= 0)
+				return false;
+		#endif
+			data += bytesRead;
+			offset += bytesRead;
+			count -= bytesRead;
+		}
+		return true;
+	}
+
+	bool File::read(std::uint64_t offset, const Segment *segments, std::size_t count) const
+	{
+	#ifdef _WIN32
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (!read(offset, segments[i].data, segments[i].size))
+				return false;
+			offset += segments[i].size;
+		}
+		return true;
+	#else
+		std::uint64_t total = 0;
+		for (std::size_t i = 0; i < count; ++i)
+			total += segments[i].size;
+		if (offset > size || total > size - offset)
+			return false;
+
+		// Reads can stop part way through a segment, so the first iovec may start inside one
+		std::size_t segment = 0, segmentDone = 0;
+		while (total > 0)
+		{
+			struct iovec vectors[IOV_BATCH];
+			int vectorCount = 0;
+			for (std::size_t i = segment; i < count && vectorCount < static_cast<int>(IOV_BATCH); ++i)
+			{
+				std::size_t done = (i == segment ? segmentDone : 0);
+				vectors[vectorCount].iov_base = segments[i].data + done;
+				vectors[vectorCount].iov_len = segments[i].size - done;
+				++vectorCount;
+			}
+
+			ssize_t bytesRead = preadv(fd, vectors, vectorCount, static_cast<off_t>(offset));
+			if (bytesRead < 0 && errno == EINTR)
+				continue;
+			if (bytesRead <= 0)
+				return false;
+
+			offset += bytesRead;
+			total -= bytesRead;
+
+			std::size_t left = static_cast<std::size_t>(bytesRead);
+			while (segment < count && left >= segments[segment].size - segmentDone)
+			{
+				left -= segments[segment].size - segmentDone;
+				++segment;
+				segmentDone = 0;
+			}
+			segmentDone += left;
+		}
+		return true;
+	#endif
+	}
+
+	void File::read(ReadRequest *requests, std::size_t count, unsigned depth, const ReadCallback &completed) const
+	{
+	#ifdef ZAP_IO_URING
+		static thread_local Ring ring;
+		if (depth > 0 && count > 0 && ring.init(std::min(depth, MAX_QUEUE_DEPTH)))
+		{
+			std::vector<bool> reported(count, false);
+			std::size_t next = 0, done = 0, queued = 0;
+
+			while (done < count && ring.ready)
+			{
+				// Keep the ring as full as possible
+				while (next < count && queued < ring.depth)
+				{
+					ReadRequest &request = requests[next];
+					if (request.size > MAX_RING_READ || request.offset > size || request.size > size - request.offset)
+					{
+						request.success = read(request.offset, request.data, request.size);
+						reported[next] = true;
+						++next;
+						++done;
+						completed(request);
+						continue;
+					}
+
+					struct io_uring_sqe *sqe = io_uring_get_sqe(&ring.ring);
+					if (sqe == nullptr)
+						break;
+
+					io_uring_prep_read(sqe, fd, request.data, static_cast<unsigned>(request.size), request.offset);
+					io_uring_sqe_set_data(sqe, &request);
+					++next;
+					++queued;
+				}
+
+				if (queued == 0)
+					continue;
+
+				int result = io_uring_submit_and_wait(&ring.ring, 1);
+				if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY)
+				{
+					// The ring is broken. The reads it never took are read synchronously below,
+					// the ones it took are reaped first, as the kernel writes to their buffers until they complete.
+					ring.broken = true;
+					queued -= io_uring_sq_ready(&ring.ring);
+				}
+
+				struct io_uring_cqe *cqe;
+				while (queued > 0)
+				{
+					int wait = (ring.broken ? io_uring_wait_cqe(&ring.ring, &cqe) : io_uring_peek_cqe(&ring.ring, &cqe));
+					if (wait == -EINTR && ring.broken)
+						continue;
+					if (wait != 0)
+						break;
+
+					ReadRequest *request = static_cast<ReadRequest*>(io_uring_cqe_get_data(cqe));
+					int res = cqe->res;
+					io_uring_cqe_seen(&ring.ring, cqe);
+					--queued;
+					++done;
+
+					// Finish short or failed reads synchronously
+					if (res >= 0 && static_cast<std::size_t>(res) == request->size)
+						request->success = true;
+					else if (res >= 0)
+						request->success = read(request->offset + res, request->data + res, request->size - res);
+					else
+						request->success = read(request->offset, request->data, request->size);
+
+					reported[request - requests] = true;
+					completed(*request);
+				}
+
+				// Only a ring that can't even be waited on leaves reads behind, closing it cancels them
+				// before their requests are read again
+				if (ring.broken)
+					ring.exit();
+			}
+
+			for (std::size_t i = 0; i < count && done < count; ++i)
+			{
+				if (reported[i])
+					continue;
+
+				requests[i].success = read(requests[i].offset, requests[i].data, requests[i].size);
+				++done;
+				completed(requests[i]);
+			}
+			return;
+		}
+	#else
+		(void)depth;
+	#endif
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			requests[i].success = read(requests[i].offset, requests[i].data, requests[i].size);
+			completed(requests[i]);
+		}
+	}
+
+	void File::advise(std::uint64_t offset, std::uint64_t count, Advice advice) const
+	{
+		if (offset >= size)
+			return;
+		count = std::min(count, size - offset);
+
+	#if defined(_WIN32)
+		// There is nothing like fadvise for file handles
+		(void)advice;
+	#elif defined(__APPLE__)
+		if (fd < 0 || advice != Advice::WILL_NEED)
+			return;
+
+		struct radvisory hint;
+		hint.ra_offset = static_cast<off_t>(offset);
+		hint.ra_count = static_cast<int>(std::min<std::uint64_t>(count, INT_MAX));
+		fcntl(fd, F_RDADVISE, &hint);
+	#else
+		if (fd < 0)
+			return;
+
+		posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(count), (advice == Advice::WILL_NEED ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED));
+	#endif
+	}
+
+	void adviseMapping(const char *data, std::size_t size, Advice advice)
+	{
+		if (data == nullptr || size == 0)
+			return;
+
+	#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		const std::uintptr_t pageSize = info.dwPageSize;
+	#else
+		const std::uintptr_t pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+	#endif
+
+		// Prefetching rounds out to whole pages, dropping rounds in, so pages shared with neighbours are kept
+		std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(data);
+		std::uintptr_t end = begin + size;
+		if (advice == Advice::WILL_NEED)
+		{
+			begin = begin / pageSize * pageSize;
+			end = (end + pageSize - 1) / pageSize * pageSize;
+		}
+		else
+		{
+			begin = (begin + pageSize - 1) / pageSize * pageSize;
+			end = end / pageSize * pageSize;
+		}
+		if (begin >= end)
+			return;
+
+	#ifdef _WIN32
+		if (advice == Advice::WILL_NEED)
+		{
+		#if _WIN32_WINNT >= 0x0602
+			WIN32_MEMORY_RANGE_ENTRY range;
+			range.VirtualAddress = reinterpret_cast<void*>(begin);
+			range.NumberOfBytes = static_cast<SIZE_T>(end - begin);
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+		#endif
+		}
+		else
+		{
+			// Unlocking pages that aren't locked removes them from the working set
+			VirtualUnlock(reinterpret_cast<void*>(begin), static_cast<SIZE_T>(end - begin));
+		}
+	#else
+		madvise(reinterpret_cast<void*>(begin), static_cast<std::size_t>(end - begin), (advice == Advice::WILL_NEED ? MADV_WILLNEED : MADV_DONTNEED));
+	#endif
+	}
+
+	bool mapFile(const std::string &filename, std::shared_ptr<const char> &data, std::size_t &size)
+	{
+	#ifdef _WIN32
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 || static_cast<std::uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		// The view keeps the file open, so both handles can be closed right away
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			return false;
+
+		void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (view == nullptr)
+			return false;
+
+		data = std::shared_ptr<const char>(static_cast<const char*>(view), [](const char *p)
+		{
+			UnmapViewOfFile(p);
+		});
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+		return true;
+	#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat sb;
+		if (fstat(fd, &sb) != 0 || sb.st_size <= 0 || static_cast<std::uint64_t>(sb.st_size) > SIZE_MAX)
+		{
+			::close(fd);
+			return false;
+		}
+
+		// The mapping keeps the file referenced, so the descriptor can be closed right away
+		std::size_t mapSize = static_cast<std::size_t>(sb.st_size);
+		void *view = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED)
+			return false;
+
+		data = std::shared_ptr<const char>(static_cast<const char*>(view), [mapSize](const char *p)
+		{
+			munmap(const_cast<char*>(p), mapSize);
+		});
+		size = mapSize;
+		return true;
+	#endif
+	}
+}
@@ -0,0 +1,149 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_File_h__
+#define ZAP_File_h__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace ZAP
+{
+	///\brief Hints about how part of a file or mapping will be used.
+	enum class Advice
+	{
+		WILL_NEED, ///< Will be read soon, so start reading it in.
+		DONT_NEED  ///< Won't be read again soon, so the cached pages can be dropped.
+	};
+
+	///\brief Read-only file that is read with positional reads.
+	///
+	/// There is no shared file position, so any number of threads can read from the same File at once.
+	class File
+	{
+	public:
+		///\brief One read in a batch.
+		struct ReadRequest
+		{
+			std::uint64_t offset; ///< Position in the file to read from.
+			char *data;           ///< Buffer to read to, needs to hold size bytes.
+			std::size_t size;     ///< Number of bytes to read.
+			bool success;         ///< Set when the read has completed.
+		};
+		typedef std::function<void(ReadRequest &request)> ReadCallback;
+
+		///\brief One buffer of a scattered read.
+		struct Segment
+		{
+			char *data;       ///< Buffer to read to, needs to hold size bytes.
+			std::size_t size; ///< Number of bytes to read into this buffer.
+		};
+
+		///\brief Largest depth of a batched read, larger depths are clamped to it.
+		static const unsigned MAX_QUEUE_DEPTH = 4096;
+
+		File();
+		~File();
+
+		///\brief Opens a file for reading.
+		///\param filename Filename of the file.
+		///\return false if the file can't be opened.
+		bool open(const std::string &filename);
+
+		///\brief Closes the file.
+		void close();
+
+		///\brief Checks if the file is opened.
+		bool isOpen() const;
+
+		///\brief Returns the size of the file in bytes.
+		std::uint64_t getSize() const;
+
+		///\brief Reads from a position in the file.
+		///\param offset Position in the file to read from.
+		///\param [out] data Buffer to read to, needs to hold size bytes.
+		///\param size Number of bytes to read.
+		///\return false if all of the bytes could not be read.
+		bool read(std::uint64_t offset, char *data, std::size_t size) const;
+
+		///\brief Gives the OS a hint about part of the file.
+		///
+		/// Uses posix_fadvise, or F_RDADVISE on macOS, which only supports WILL_NEED. Does nothing on Windows.
+		///\param offset Position in the file.
+		///\param count Number of bytes.
+		///\param advice The hint.
+		void advise(std::uint64_t offset, std::uint64_t count, Advice advice) const;
+
+		///\brief Reads a contiguous part of the file, scattered over several buffers.
+		///
+		/// Uses preadv, so the whole range takes as few syscalls as possible. On Windows,
+		/// where scattered reads need unbuffered, page-aligned I/O, every buffer is read on its own.
+		///\param offset Position in the file to read from.
+		///\param segments The buffers, filled in order.
+		///\param count Number of buffers.
+		///\return false if all of the bytes could not be read.
+		bool read(std::uint64_t offset, const Segment *segments, std::size_t count) const;
+
+		///\brief Reads a batch of requests.
+		///
+		/// With io_uring, up to depth requests are in flight at once, in a ring the calling thread keeps
+		/// until it reads with another depth. Otherwise they are read one at a time. Requests can complete in any order.
+		///\param requests The requests.
+		///\param count Number of requests.
+		///\param depth Number of requests in flight at once, at most MAX_QUEUE_DEPTH. 0 reads them one at a time.
+		///\param completed Called for every request as soon as it has completed, on the calling thread.
+		void read(ReadRequest *requests, std::size_t count, unsigned depth, const ReadCallback &completed) const;
+
+	private:
+		File(const File&) = delete;
+		File &operator=(const File&) = delete;
+
+	#ifdef _WIN32
+		void *handle;
+	#else
+		int fd;
+	#endif
+		std::uint64_t size;
+	};
+
+	///\brief Gives the OS a hint about part of a mapping from mapFile().
+	///
+	/// Uses madvise, or PrefetchVirtualMemory and VirtualUnlock on Windows.
+	/// Must not be used on other memory, as dropped pages of anonymous memory are lost.
+	///\param data The first byte.
+	///\param size Number of bytes.
+	///\param advice The hint.
+	void adviseMapping(const char *data, std::size_t size, Advice advice);
+
+	///\brief Maps a whole file read-only into memory.
+	///
+	/// The mapping is released when the last copy of data is destroyed.
+	///\param filename Filename of the file to map.
+	///\param [out] data The mapped memory, untouched if failed.
+	///\param [out] size The size of the mapping, untouched if failed.
+	///\return false if the file can't be opened, is empty, or can't be mapped.
+	bool mapFile(const std::string &filename, std::shared_ptr<const char> &data, std::size_t &size);
+}
+
+#endif // ZAP_File_h__
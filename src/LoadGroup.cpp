@@ -0,0 +1,69 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include <ZAP/LoadGroup.h>
+
+namespace ZAP
+{
+	LoadGroup::LoadGroup() : pending(0), generation(0)
+	{
+	}
+	LoadGroup::~LoadGroup()
+	{
+		wait();
+	}
+
+	void LoadGroup::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this]() { return (pending == 0); });
+	}
+
+	void LoadGroup::cancel()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++generation;
+	}
+
+	std::size_t LoadGroup::getPendingCount() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return pending;
+	}
+
+	std::uint64_t LoadGroup::begin()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++pending;
+		return generation;
+	}
+	bool LoadGroup::isCancelled(std::uint64_t load_generation) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return (generation != load_generation);
+	}
+	void LoadGroup::end()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pending == 0)
+			condition.notify_all();
+	}
+}
@@ -0,0 +1,278 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include <ZAP/MemoryResource.h>
+
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace
+{
+	// Allocations go through new char[], so buffers can still be freed with delete[].
+	// Failures return null as allocate() promises, instead of throwing std::bad_alloc.
+	class DefaultResource : public ZAP::MemoryResource
+	{
+	protected:
+		void *doAllocate(std::size_t bytes, std::size_t alignment) override
+		{
+			if (alignment > alignof(std::max_align_t))
+				return nullptr;
+
+			return new (std::nothrow) char[bytes];
+		}
+		void doDeallocate(void *data, std::size_t, std::size_t) override
+		{
+			delete[] static_cast<char*>(data);
+		}
+	};
+}
+
+namespace ZAP
+{
+	MemoryResource::~MemoryResource()
+	{
+	}
+
+	void *MemoryResource::allocate(std::size_t bytes, std::size_t alignment)
+	{
+		return doAllocate(bytes, alignment);
+	}
+
+	void MemoryResource::deallocate(void *data, std::size_t bytes, std::size_t alignment)
+	{
+		doDeallocate(data, bytes, alignment);
+	}
+
+	bool MemoryResource::isEqual(const MemoryResource &other) const
+	{
+		return (this == &other || doIsEqual(other));
+	}
+
+	bool MemoryResource::doIsEqual(const MemoryResource &other) const
+	{
+		return (this == &other);
+	}
+
+	MemoryResource *getDefaultResource()
+	{
+		static DefaultResource resource;
+		return &resource;
+	}
+
+	MonotonicResource::MonotonicResource(std::size_t chunk_size, MemoryResource *upstream)
+		: upstream(upstream != nullptr ? upstream : getDefaultResource()), chunkSize(chunk_size), current(nullptr), left(0)
+	{
+	}
+	MonotonicResource::~MonotonicResource()
+	{
+		release();
+	}
+
+	void MonotonicResource::release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (const Chunk &chunk : chunks)
+		{
+			upstream->deallocate(chunk.data, chunk.size);
+		}
+		chunks.clear();
+		current = nullptr;
+		left = 0;
+	}
+
+	std::size_t MonotonicResource::getReservedSize() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::size_t size = 0;
+		for (const Chunk &chunk : chunks)
+		{
+			size += chunk.size;
+		}
+		return size;
+	}
+
+	void *MonotonicResource::doAllocate(std::size_t bytes, std::size_t alignment)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::size_t padding = static_cast<std::size_t>(-reinterpret_cast<std::uintptr_t>(current) & (alignment - 1));
+		if (current == nullptr || padding + bytes > left)
+		{
+			// Leave room to align the allocation in case the chunk itself isn't aligned enough
+			std::size_t size = (bytes + alignment - 1 > chunkSize ? bytes + alignment - 1 : chunkSize);
+			void *data = upstream->allocate(size);
+			if (data == nullptr)
+				return nullptr;
+
+			Chunk chunk = { data, size };
+			chunks.push_back(chunk);
+			current = static_cast<char*>(data);
+			left = size;
+			padding = static_cast<std::size_t>(-reinterpret_cast<std::uintptr_t>(current) & (alignment - 1));
+		}
+
+		char *data = current + padding;
+		current = data + bytes;
+		left -= padding + bytes;
+		return data;
+	}
+
+	void MonotonicResource::doDeallocate(void *, std::size_t, std::size_t)
+	{
+	}
+
+	const std::size_t BufferPool::MIN_CLASS_SHIFT;
+	const std::size_t BufferPool::MAX_CLASS_SHIFT;
+	const std::size_t BufferPool::CLASS_COUNT;
+
+	BufferPool::BufferPool(std::size_t budget, MemoryResource *upstream)
+		: upstream(upstream != nullptr ? upstream : getDefaultResource())
+	{
+		stats.budget = budget;
+	}
+	BufferPool::~BufferPool()
+	{
+		trim();
+	}
+
+	void BufferPool::trim()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (std::size_t c = 0; c < CLASS_COUNT; ++c)
+		{
+			std::size_t size = getSizeOfClass(c);
+			for (void *data : freeLists[c])
+			{
+				upstream->deallocate(data, size);
+				++stats.deallocations;
+			}
+			freeLists[c].clear();
+		}
+		stats.size = 0;
+	}
+
+	BufferPoolStats BufferPool::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	std::size_t BufferPool::getClass(std::size_t bytes)
+	{
+		if (bytes <= (std::size_t(1) << MIN_CLASS_SHIFT))
+			return 0;
+
+		// Split (2^shift, 2^(shift + 1)] into four steps
+		std::size_t last = bytes - 1;
+		std::size_t shift = MIN_CLASS_SHIFT;
+		while ((last >> (shift + 1)) != 0)
+			++shift;
+
+		if (shift >= MAX_CLASS_SHIFT)
+			return CLASS_COUNT;
+
+		std::size_t step = (last >> (shift - 2)) & 3;
+		return (shift - MIN_CLASS_SHIFT) * 4 + step + 1;
+	}
+
+	std::size_t BufferPool::getSizeOfClass(std::size_t c)
+	{
+		if (c == 0)
+			return (std::size_t(1) << MIN_CLASS_SHIFT);
+
+		std::size_t shift = (c - 1) / 4 + MIN_CLASS_SHIFT;
+		std::size_t step = (c - 1) % 4;
+		return (4 + step + 1) << (shift - 2);
+	}
+
+	std::size_t BufferPool::getClassSize(std::size_t bytes)
+	{
+		std::size_t c = getClass(bytes);
+		return (c == CLASS_COUNT ? bytes : getSizeOfClass(c));
+	}
+
+	void *BufferPool::doAllocate(std::size_t bytes, std::size_t alignment)
+	{
+		std::size_t c = getClass(bytes);
+		if (c == CLASS_COUNT || alignment > alignof(std::max_align_t))
+		{
+			void *data = upstream->allocate(bytes, alignment);
+			if (data != nullptr)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				++stats.allocations;
+			}
+			return data;
+		}
+
+		std::size_t size = getSizeOfClass(c);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!freeLists[c].empty())
+			{
+				void *data = freeLists[c].back();
+				freeLists[c].pop_back();
+				stats.size -= size;
+				++stats.reuses;
+				return data;
+			}
+		}
+
+		void *data = upstream->allocate(size);
+		if (data != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++stats.allocations;
+		}
+		return data;
+	}
+
+	void BufferPool::doDeallocate(void *data, std::size_t bytes, std::size_t alignment)
+	{
+		std::size_t c = getClass(bytes);
+		if (c == CLASS_COUNT || alignment > alignof(std::max_align_t))
+		{
+			upstream->deallocate(data, bytes, alignment);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			++stats.deallocations;
+			return;
+		}
+
+		std::size_t size = getSizeOfClass(c);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stats.size + size <= stats.budget)
+			{
+				freeLists[c].push_back(data);
+				stats.size += size;
+				return;
+			}
+			++stats.deallocations;
+		}
+
+		upstream->deallocate(data, size);
+	}
+}
@@ -0,0 +1,185 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "PerfectHash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Average number of hashes per bucket, more makes the function smaller and slower to build
+	const std::uint32_t BUCKET_LOAD = 5;
+
+	// Displacements with this bit set hold the slot of their single hash instead
+	const std::uint32_t DIRECT_SLOT = 0x80000000u;
+
+	// Displacements to try per bucket before starting over with the next seed
+	const std::uint32_t MAX_DISPLACEMENT = 1u << 20;
+	const std::uint32_t MAX_SEEDS = 16;
+
+	// Finalizer of MurmurHash3, spreads FNV-1a's weaker bits over the whole word
+	inline std::uint64_t mix(std::uint64_t x)
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ull;
+		x ^= x >> 33;
+		return x;
+	}
+
+	inline std::uint32_t getBucket(std::uint64_t hash, std::uint32_t seed, std::uint32_t bucket_count)
+	{
+		return static_cast<std::uint32_t>(mix(hash ^ (seed * 0x9e3779b97f4a7c15ull)) % bucket_count);
+	}
+
+	inline std::uint32_t getSlot(std::uint64_t hash, std::uint32_t seed, std::uint32_t displacement, std::uint32_t size)
+	{
+		return static_cast<std::uint32_t>(mix(hash ^ (seed * 0x9e3779b97f4a7c15ull) ^ ((displacement + 1ull) * 0xc2b2ae3d27d4eb4full)) % size);
+	}
+
+	bool tryBuild(const std::vector<std::uint64_t> &hashes, std::uint32_t seed, std::vector<std::uint32_t> &displacements, std::vector<std::uint32_t> &slots)
+	{
+		const std::uint32_t size = static_cast<std::uint32_t>(hashes.size());
+		const std::uint32_t bucketCount = static_cast<std::uint32_t>(displacements.size());
+
+		// Group the hashes by bucket, with a counting sort
+		std::vector<std::uint32_t> bucketOf(size);
+		std::vector<std::uint32_t> bucketBegin(bucketCount + 1, 0);
+		for (std::uint32_t i = 0; i < size; ++i)
+		{
+			bucketOf[i] = getBucket(hashes[i], seed, bucketCount);
+			++bucketBegin[bucketOf[i] + 1];
+		}
+		for (std::uint32_t b = 0; b < bucketCount; ++b)
+		{
+			bucketBegin[b + 1] += bucketBegin[b];
+		}
+		std::vector<std::uint32_t> members(size);
+		{
+			std::vector<std::uint32_t> next(bucketBegin.begin(), bucketBegin.end() - 1);
+			for (std::uint32_t i = 0; i < size; ++i)
+			{
+				members[next[bucketOf[i]]++] = i;
+			}
+		}
+
+		// Large buckets are placed first, while most slots are still free
+		std::vector<std::uint32_t> order(bucketCount);
+		for (std::uint32_t b = 0; b < bucketCount; ++b)
+		{
+			order[b] = b;
+		}
+		std::stable_sort(order.begin(), order.end(), [&bucketBegin](std::uint32_t lhs, std::uint32_t rhs)
+		{
+			return (bucketBegin[lhs + 1] - bucketBegin[lhs] > bucketBegin[rhs + 1] - bucketBegin[rhs]);
+		});
+
+		std::vector<bool> taken(size, false);
+		std::vector<std::uint32_t> candidate;
+		std::uint32_t nextFree = 0;
+		for (std::uint32_t b : order)
+		{
+			const std::uint32_t *first = members.data() + bucketBegin[b];
+			const std::uint32_t count = bucketBegin[b + 1] - bucketBegin[b];
+			if (count == 0)
+			{
+				displacements[b] = 0;
+				continue;
+			}
+
+			if (count == 1)
+			{
+				// No search needed, the hash takes the next free slot
+				while (taken[nextFree])
+					++nextFree;
+
+				taken[nextFree] = true;
+				slots[first[0]] = nextFree;
+				displacements[b] = DIRECT_SLOT | nextFree;
+				continue;
+			}
+
+			bool placed = false;
+			for (std::uint32_t displacement = 0; displacement < MAX_DISPLACEMENT && !placed; ++displacement)
+			{
+				candidate.clear();
+				for (std::uint32_t m = 0; m < count; ++m)
+				{
+					std::uint32_t slot = getSlot(hashes[first[m]], seed, displacement, size);
+					if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+						break;
+					candidate.push_back(slot);
+				}
+				if (candidate.size() != count)
+					continue;
+
+				for (std::uint32_t m = 0; m < count; ++m)
+				{
+					taken[candidate[m]] = true;
+					slots[first[m]] = candidate[m];
+				}
+				displacements[b] = displacement;
+				placed = true;
+			}
+
+			if (!placed)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+namespace ZAP
+{
+	bool buildPerfectHash(const std::vector<std::uint64_t> &hashes, std::uint32_t &seed, std::vector<std::uint32_t> &displacements, std::vector<std::uint32_t> &slots)
+	{
+		if (hashes.empty() || hashes.size() >= DIRECT_SLOT)
+			return false;
+
+		const std::uint32_t size = static_cast<std::uint32_t>(hashes.size());
+		displacements.assign((size + BUCKET_LOAD - 1) / BUCKET_LOAD, 0);
+		slots.assign(size, 0);
+
+		for (std::uint32_t s = 0; s < MAX_SEEDS; ++s)
+		{
+			if (tryBuild(hashes, s, displacements, slots))
+			{
+				seed = s;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::uint32_t findPerfectHashSlot(std::uint64_t hash, std::uint32_t seed, const char *displacements, std::uint32_t bucket_count, std::uint32_t size)
+	{
+		std::uint32_t displacement;
+		std::memcpy(&displacement, displacements + static_cast<std::size_t>(getBucket(hash, seed, bucket_count)) * sizeof(displacement), sizeof(displacement));
+
+		if (displacement & DIRECT_SLOT)
+			return (displacement & ~DIRECT_SLOT) % size;
+
+		return getSlot(hash, seed, displacement, size);
+	}
+}
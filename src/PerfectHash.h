@@ -0,0 +1,55 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_PerfectHash_h__
+#define ZAP_PerfectHash_h__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ZAP
+{
+	///\brief Builds a minimal perfect hash function over distinct 64-bit hashes, with hash and displace (CHD).
+	///
+	/// Every hash falls in a bucket, about five to a bucket, and every bucket gets a displacement
+	/// that moves its hashes to slots no other bucket uses. Buckets with a single hash store their slot directly.
+	/// The function takes four bytes per bucket, see findPerfectHashSlot().
+	///\param hashes The hashes, no two the same.
+	///\param [out] seed Seed of the function.
+	///\param [out] displacements Displacement of every bucket.
+	///\param [out] slots Slot of every hash, in the same order as hashes. The slots are 0 to hashes.size() - 1.
+	///\return false if no function was found, which is all but impossible for distinct hashes.
+	bool buildPerfectHash(const std::vector<std::uint64_t> &hashes, std::uint32_t &seed, std::vector<std::uint32_t> &displacements, std::vector<std::uint32_t> &slots);
+
+	///\brief Returns the slot of a hash.
+	///
+	/// Hashes the function wasn't built with map to some slot too, so the caller needs to check the hash in the slot.
+	///\param hash The hash.
+	///\param seed Seed of the function.
+	///\param displacements Displacement of every bucket, as 32-bit values in native byte order, doesn't need to be aligned.
+	///\param bucket_count Number of buckets, not 0.
+	///\param size Number of slots, not 0.
+	///\return The slot, below size.
+	std::uint32_t findPerfectHashSlot(std::uint64_t hash, std::uint32_t seed, const char *displacements, std::uint32_t bucket_count, std::uint32_t size);
+}
+
+#endif // ZAP_PerfectHash_h__
@@ -0,0 +1,84 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Scan.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define ZAP_SCAN_SSE2
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+namespace
+{
+	std::size_t findTerminatorScalar(const char *data, std::size_t size)
+	{
+		const char *found = static_cast<const char*>(std::memchr(data, '\0', size));
+		return (found != nullptr ? static_cast<std::size_t>(found - data) : size);
+	}
+
+#ifdef ZAP_SCAN_SSE2
+	inline unsigned countTrailingZeros(unsigned mask)
+	{
+	#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned>(index);
+	#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+	#endif
+	}
+
+	// SSE2 is part of x86-64, so this needs no check
+	std::size_t findTerminatorSSE2(const char *data, std::size_t size)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)));
+			if (mask != 0)
+				return i + countTrailingZeros(mask);
+		}
+
+		// Less than a full block is left
+		return i + findTerminatorScalar(data + i, size - i);
+	}
+#endif
+}
+
+namespace ZAP
+{
+	std::size_t findTerminator(const char *data, std::size_t size)
+	{
+	#ifdef ZAP_SCAN_SSE2
+		return findTerminatorSSE2(data, size);
+	#else
+		return findTerminatorScalar(data, size);
+	#endif
+	}
+}
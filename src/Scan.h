@@ -0,0 +1,40 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_Scan_h__
+#define ZAP_Scan_h__
+
+#include <cstddef>
+
+namespace ZAP
+{
+	///\brief Finds the first zero byte.
+	///
+	/// Scans 16 bytes at a time with SSE2 on x86-64, and uses memchr everywhere else.
+	/// Paths are short, so AVX2 didn't pay for its wider blocks and the check at runtime.
+	/// Never reads outside of the given range.
+	///\param data The bytes to scan.
+	///\param size Number of bytes to scan.
+	///\return The position of the first zero byte, or size if there is none.
+	std::size_t findTerminator(const char *data, std::size_t size);
+}
+
+#endif // ZAP_Scan_h__
@@ -0,0 +1,92 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include <ZAP/WorkerPool.h>
+
+namespace ZAP
+{
+	WorkerPool::WorkerPool(std::size_t thread_count) : stopping(false)
+	{
+		if (thread_count == 0)
+			thread_count = std::thread::hardware_concurrency();
+		if (thread_count == 0)
+			thread_count = 1;
+
+		threads.reserve(thread_count);
+		for (std::size_t i = 0; i < thread_count; ++i)
+		{
+			threads.emplace_back(&WorkerPool::run, this);
+		}
+	}
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	std::size_t WorkerPool::getThreadCount() const
+	{
+		return threads.size();
+	}
+
+	void WorkerPool::submit(Task task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	WorkerPool &WorkerPool::getDefault()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	void WorkerPool::run()
+	{
+		for (;;)
+		{
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return (stopping || !tasks.empty()); });
+
+				// Queued tasks are still run when stopping, so nobody is left waiting on them
+				if (tasks.empty())
+					return;
+
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+}
@@ -0,0 +1,124 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <ZAP/LoadGroup.h>
+#include <ZAP/WorkerPool.h>
+
+#include <atomic>
+#include <cstring>
+#include <future>
+
+using namespace ZAP;
+
+namespace
+{
+	void checkAsyncLoads(const Archive &archive, const Test::Files &files)
+	{
+		const std::vector<Test::Files::File> &all = files.getFiles();
+
+		LoadGroup group;
+		std::vector<std::future<Archive::LoadResult>> futures;
+		for (std::size_t n = 0; n < 4; ++n)
+		{
+			for (const Test::Files::File &file : all)
+				futures.push_back(archive.loadAsync(file.virtual_path, &group));
+		}
+
+		for (std::size_t i = 0; i < futures.size(); ++i)
+		{
+			Archive::LoadResult result = futures[i].get();
+			const std::string &expected = all[i % all.size()].data;
+			ZAP_CHECK(result.success && !result.cancelled);
+			ZAP_CHECK(result.size == expected.size() && std::memcmp(result.data.getData(), expected.data(), expected.size()) == 0);
+		}
+
+		group.wait();
+		ZAP_CHECK(group.getPendingCount() == 0);
+	}
+
+	// Loads still queued behind a busy worker are cancelled, later loads are not
+	void checkCancel(Archive &archive, const Test::Files &files)
+	{
+		const std::vector<Test::Files::File> &all = files.getFiles();
+
+		WorkerPool pool(1);
+		archive.setWorkerPool(&pool);
+
+		std::promise<void> unblock;
+		std::shared_future<void> blocked = unblock.get_future().share();
+		pool.submit([blocked]() { blocked.wait(); });
+
+		LoadGroup group;
+		std::vector<std::future<Archive::LoadResult>> cancelled;
+		for (const Test::Files::File &file : all)
+			cancelled.push_back(archive.loadAsync(file.virtual_path, &group));
+
+		std::atomic<std::size_t> callbacks(0);
+		archive.loadAsync(all[0].virtual_path, [&callbacks](Archive::LoadResult &result)
+		{
+			if (result.cancelled && !result.success && result.data.isEmpty())
+				++callbacks;
+		}, &group);
+
+		ZAP_CHECK(group.getPendingCount() == all.size() + 1);
+		group.cancel();
+
+		std::future<Archive::LoadResult> later = archive.loadAsync(all[0].virtual_path, &group);
+		unblock.set_value();
+
+		for (std::future<Archive::LoadResult> &future : cancelled)
+		{
+			Archive::LoadResult result = future.get();
+			ZAP_CHECK(result.cancelled && !result.success && result.data.isEmpty());
+		}
+
+		Archive::LoadResult result = later.get();
+		ZAP_CHECK(!result.cancelled && result.success && result.size == all[0].data.size());
+
+		group.wait();
+		ZAP_CHECK(group.getPendingCount() == 0);
+		ZAP_CHECK(callbacks == 1);
+
+		archive.setWorkerPool(nullptr);
+	}
+}
+
+int main()
+{
+	Test::Files files("Async");
+	for (unsigned i = 0; i < 40; ++i)
+		files.add("async/" + std::to_string(i), Test::makeData(100 + i * 1531, i, (i % 4) != 0));
+
+	const Compression compressions[] = { Compression::NONE, Compression::LZ4 };
+	for (Compression compression : compressions)
+	{
+		Archive archive;
+		if (!supportsCompression(compression) || !ZAP_CHECK(files.openFile(archive, compression, Version::CURRENT)))
+			continue;
+
+		checkAsyncLoads(archive, files);
+		checkCancel(archive, files);
+	}
+
+	return Test::finish();
+}
@@ -0,0 +1,135 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <cstring>
+
+using namespace ZAP;
+
+namespace
+{
+	bool equals(const char *data, const std::string &expected)
+	{
+		return (data != nullptr && std::memcmp(data, expected.data(), expected.size()) == 0);
+	}
+
+	void checkBatch(const Archive &archive, const Test::Files &files, std::size_t merge_gap)
+	{
+		const std::vector<Test::Files::File> &all = files.getFiles();
+
+		// Every other stretch of entries, backwards, so the reads have gaps and have to be sorted
+		Archive::EntryList entries;
+		std::vector<const std::string*> expected;
+		for (std::size_t i = all.size(); i-- > 0;)
+		{
+			if ((i / 3) % 2 == 0)
+			{
+				entries.push_back(archive.getEntry(all[i].virtual_path));
+				expected.push_back(&all[i].data);
+			}
+		}
+		// The same entry twice
+		entries.push_back(entries.front());
+		expected.push_back(expected.front());
+
+		std::vector<Buffer> data;
+		ZAP_CHECK(archive.getData(entries, data, merge_gap));
+		if (!ZAP_CHECK(data.size() == entries.size()))
+			return;
+
+		for (std::size_t i = 0; i < entries.size(); ++i)
+			ZAP_CHECK(data[i].getSize() == expected[i]->size() && equals(data[i].getData(), *expected[i]));
+
+		// Missing entries fail on their own, the rest is still read
+		entries.insert(entries.begin() + 1, nullptr);
+		expected.insert(expected.begin() + 1, nullptr);
+		ZAP_CHECK(!archive.getData(entries, data, merge_gap));
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			if (expected[i] == nullptr)
+				ZAP_CHECK(data[i].isEmpty());
+			else
+				ZAP_CHECK(equals(data[i].getData(), *expected[i]));
+		}
+	}
+
+	void checkRawBatch(const Archive &archive, const Test::Files &files)
+	{
+		const std::vector<Test::Files::File> &all = files.getFiles();
+
+		std::vector<std::vector<char>> buffers;
+		Archive::ReadTargetList targets;
+		for (std::size_t i = 0; i < all.size(); i += 2)
+			buffers.push_back(std::vector<char>(all[i].data.size()));
+
+		for (std::size_t i = 0, b = 0; i < all.size(); i += 2, ++b)
+		{
+			Archive::ReadTarget target = { archive.getEntry(all[i].virtual_path), buffers[b].data(), buffers[b].size(), false };
+			targets.push_back(target);
+		}
+
+		ZAP_CHECK(archive.getRawData(targets));
+		for (std::size_t i = 0, b = 0; i < all.size(); i += 2, ++b)
+			ZAP_CHECK(targets[b].success && equals(buffers[b].data(), all[i].data));
+	}
+}
+
+int main()
+{
+	Test::Files files("Batch");
+	for (unsigned i = 0; i < 60; ++i)
+		files.add("batch/" + std::to_string(i), Test::makeData(1 + i * 997 % 20000, i, (i % 3) != 0));
+	// Larger than a merged read may be
+	files.add("batch/large", Test::makeData(9 * 1024 * 1024, 100, true));
+	files.add("batch/last", Test::makeData(5000, 101, false));
+
+	const std::size_t gaps[] = { 0, 1, 4096, Archive::DEFAULT_MERGE_GAP, 64 * 1024 * 1024 };
+	const Compression compressions[] = { Compression::NONE, Compression::LZ4 };
+	for (Compression compression : compressions)
+	{
+		if (!supportsCompression(compression))
+			continue;
+
+		Archive archive;
+		if (!ZAP_CHECK(files.openFile(archive, compression, Version::CURRENT)))
+			continue;
+
+		std::vector<char> data;
+		ZAP_CHECK(files.buildMemory(data, compression, Version::CURRENT));
+		Archive memory;
+		ZAP_CHECK(memory.openBorrowedMemory(data.data(), data.size()));
+
+		for (std::size_t gap : gaps)
+		{
+			checkBatch(archive, files, gap);
+			checkBatch(memory, files, gap);
+		}
+
+		if (compression == Compression::NONE)
+		{
+			checkRawBatch(archive, files);
+			checkRawBatch(memory, files);
+		}
+	}
+
+	return Test::finish();
+}
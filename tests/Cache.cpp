@@ -0,0 +1,111 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <ZAP/EntryCache.h>
+
+using namespace ZAP;
+
+namespace
+{
+	std::shared_ptr<const char> makeEntry(std::size_t size)
+	{
+		return std::shared_ptr<const char>(new char[size], std::default_delete<char[]>());
+	}
+
+	bool isCached(EntryCache &cache, std::size_t key)
+	{
+		std::shared_ptr<const char> data;
+		std::size_t size;
+		return cache.find(key, data, size);
+	}
+
+	// Entries are far larger than a shard's share of the budget would be, and land in different shards
+	void checkBudget(CachePolicy policy)
+	{
+		const std::size_t budget = 1000000;
+		EntryCache cache(budget, policy);
+
+		cache.insert(1, makeEntry(400000), 400000);
+		cache.insert(2, makeEntry(400000), 400000);
+		ZAP_CHECK(isCached(cache, 1) && isCached(cache, 2));
+		ZAP_CHECK(cache.getStats().size == 800000);
+
+		// Entry 1 was used last, so entry 2 makes room
+		ZAP_CHECK(isCached(cache, 1));
+		cache.insert(3, makeEntry(400000), 400000);
+		ZAP_CHECK(isCached(cache, 1) && !isCached(cache, 2) && isCached(cache, 3));
+		ZAP_CHECK(cache.getStats().size <= budget && cache.getStats().evictions == 1);
+
+		// A single entry can take the whole budget, but not more
+		cache.insert(4, makeEntry(budget), budget);
+		ZAP_CHECK(isCached(cache, 4) && cache.getStats().size == budget);
+		cache.insert(5, makeEntry(budget + 1), budget + 1);
+		ZAP_CHECK(!isCached(cache, 5) && isCached(cache, 4));
+
+		cache.clear();
+		ZAP_CHECK(cache.getStats().size == 0 && !isCached(cache, 4));
+		cache.insert(6, makeEntry(budget), budget);
+		ZAP_CHECK(isCached(cache, 6));
+	}
+
+	// Entries used twice survive a scan over many entries used once
+	void checkScanResistance()
+	{
+		EntryCache cache(1000000, CachePolicy::SEGMENTED_LRU);
+		cache.insert(1, makeEntry(100000), 100000);
+		ZAP_CHECK(isCached(cache, 1));
+
+		for (std::size_t key = 100; key < 200; ++key)
+			cache.insert(key, makeEntry(100000), 100000);
+
+		ZAP_CHECK(isCached(cache, 1));
+		ZAP_CHECK(cache.getStats().size <= 1000000);
+	}
+}
+
+int main()
+{
+	checkBudget(CachePolicy::LRU);
+	checkBudget(CachePolicy::SEGMENTED_LRU);
+	checkScanResistance();
+
+	// Through an archive, with entries of a quarter of the budget each
+	Test::Files files("Cache");
+	for (unsigned i = 0; i < 8; ++i)
+		files.add("cache/" + std::to_string(i), Test::makeData(250000, i, true));
+
+	Archive archive;
+	archive.setCache(1000000);
+	if (ZAP_CHECK(files.openFile(archive, Compression::NONE, Version::CURRENT)))
+	{
+		for (std::size_t n = 0; n < 2; ++n)
+		{
+			for (std::size_t i = 0; i < 3; ++i)
+				ZAP_CHECK(Test::hasData(archive, archive.getEntry(files.getFiles()[i].virtual_path), files.getFiles()[i].data));
+		}
+		CacheStats stats = archive.getCacheStats();
+		ZAP_CHECK(stats.hits == 3 && stats.misses == 3 && stats.size == 750000);
+	}
+
+	return Test::finish();
+}
@@ -0,0 +1,243 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+
+using namespace ZAP;
+
+namespace
+{
+	const std::size_t THREAD_COUNT = 8;
+
+	// Holds back allocations of one size until opened, and counts them. Can also fail them by throwing.
+	class GateResource : public MemoryResource
+	{
+	public:
+		explicit GateResource(std::size_t size) : size(size), open(false), failing(false), waiting(0), allocations(0) {}
+
+		void setFailing(bool failing)
+		{
+			this->failing = failing;
+		}
+
+		void waitForAllocation()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return waiting > 0; });
+		}
+		void release()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			open = true;
+			condition.notify_all();
+		}
+		std::size_t getAllocations() const
+		{
+			return allocations;
+		}
+
+	protected:
+		void *doAllocate(std::size_t bytes, std::size_t alignment) override
+		{
+			if (bytes == size)
+			{
+				++allocations;
+				std::unique_lock<std::mutex> lock(mutex);
+				++waiting;
+				condition.notify_all();
+				condition.wait(lock, [this]() { return open; });
+				if (failing)
+					throw std::bad_alloc();
+			}
+			return getDefaultResource()->allocate(bytes, alignment);
+		}
+		void doDeallocate(void *data, std::size_t bytes, std::size_t alignment) override
+		{
+			getDefaultResource()->deallocate(data, bytes, alignment);
+		}
+
+	private:
+		std::size_t size;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool open;
+		std::atomic<bool> failing;
+		std::size_t waiting;
+		std::atomic<std::size_t> allocations;
+	};
+
+	// Threads that miss the cache on the same entry at once share a single load
+	void checkCachedLoads(const std::string &filename, const Test::Files::File &file)
+	{
+		GateResource gate(file.data.size());
+		Archive archive;
+		archive.setMemoryResource(&gate);
+		archive.setCache(64 * 1024 * 1024);
+		if (!ZAP_CHECK(archive.openFile(filename)))
+			return;
+
+		const Archive::Entry *entry = archive.getEntry(file.virtual_path);
+		std::vector<Archive::View> views(THREAD_COUNT);
+		std::vector<std::thread> threads;
+		threads.emplace_back([&]() { archive.getView(entry, views[0]); });
+
+		// The first load is now stuck in its allocation, the others have to join it
+		gate.waitForAllocation();
+		for (std::size_t t = 1; t < THREAD_COUNT; ++t)
+			threads.emplace_back([&, t]() { archive.getView(entry, views[t]); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		gate.release();
+
+		for (std::thread &thread : threads)
+			thread.join();
+
+		ZAP_CHECK(gate.getAllocations() == 1);
+		for (const Archive::View &view : views)
+		{
+			ZAP_CHECK(view.data == views[0].data);
+			ZAP_CHECK(view.size == file.data.size() && view.data != nullptr && std::memcmp(view.data.get(), file.data.data(), view.size) == 0);
+		}
+	}
+
+	// Without a cache, loads into the callers' buffers still read and decompress the entry once.
+	// The compressed data is staged in one allocation per read, which is what is counted.
+	void checkUncachedLoads(const std::string &filename, const Test::Files::File &file)
+	{
+		Archive archive;
+		if (!ZAP_CHECK(archive.openFile(filename)))
+			return;
+
+		const Archive::Entry *entry = archive.getEntry(file.virtual_path);
+		if (!ZAP_CHECK(entry != nullptr && entry->compressed_size != entry->decompressed_size))
+			return;
+
+		GateResource gate(static_cast<std::size_t>(entry->compressed_size));
+		archive.setMemoryResource(&gate);
+
+		std::future<Archive::LoadResult> first = archive.loadAsync(entry);
+		gate.waitForAllocation();
+
+		std::vector<std::vector<char>> buffers(THREAD_COUNT, std::vector<char>(file.data.size()));
+		std::vector<char> results(THREAD_COUNT, 0);
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < THREAD_COUNT; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::size_t size = 0;
+				results[t] = archive.getData(entry, buffers[t].data(), buffers[t].size(), size) && size == file.data.size();
+			});
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		gate.release();
+
+		for (std::thread &thread : threads)
+			thread.join();
+		Archive::LoadResult result = first.get();
+
+		ZAP_CHECK(gate.getAllocations() == 1);
+		ZAP_CHECK(result.success && result.size == file.data.size() && std::memcmp(result.data.getData(), file.data.data(), result.size) == 0);
+		for (std::size_t t = 0; t < THREAD_COUNT; ++t)
+			ZAP_CHECK(results[t] && std::memcmp(buffers[t].data(), file.data.data(), file.data.size()) == 0);
+
+		archive.close();
+	}
+
+	// A load that throws leaves nothing behind, loads that joined it throw as well
+	void checkFailingResource(const std::string &filename, const Test::Files::File &file)
+	{
+		GateResource gate(file.data.size());
+		gate.setFailing(true);
+		Archive archive;
+		archive.setMemoryResource(&gate);
+		archive.setCache(64 * 1024 * 1024);
+		if (!ZAP_CHECK(archive.openFile(filename)))
+			return;
+
+		const Archive::Entry *entry = archive.getEntry(file.virtual_path);
+		std::atomic<std::size_t> exceptions(0);
+		auto load = [&]()
+		{
+			Archive::View view;
+			try
+			{
+				archive.getView(entry, view);
+			}
+			catch (const std::bad_alloc&)
+			{
+				++exceptions;
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.emplace_back(load);
+		gate.waitForAllocation();
+		for (std::size_t t = 1; t < THREAD_COUNT; ++t)
+			threads.emplace_back(load);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		gate.release();
+
+		for (std::thread &thread : threads)
+			thread.join();
+		ZAP_CHECK(exceptions == THREAD_COUNT);
+
+		Archive::LoadResult result = archive.loadAsync(entry).get();
+		ZAP_CHECK(!result.success && !result.cancelled && result.data.isEmpty());
+
+		gate.setFailing(false);
+		Archive::View view;
+		ZAP_CHECK(archive.getView(entry, view) && view.size == file.data.size() && std::memcmp(view.data.get(), file.data.data(), view.size) == 0);
+		ZAP_CHECK(Test::hasData(archive, entry, file.data));
+	}
+}
+
+int main()
+{
+	Test::Files files("Coalescing");
+	for (unsigned i = 0; i < 4; ++i)
+		files.add("coalescing/" + std::to_string(i), Test::makeData(10000 + i * 1531, i, true));
+
+	const Compression compressions[] = { Compression::NONE, Compression::LZ4 };
+	for (Compression compression : compressions)
+	{
+		if (!supportsCompression(compression))
+			continue;
+
+		const std::string filename = files.buildFile(compression, Version::CURRENT);
+		if (!ZAP_CHECK(!filename.empty()))
+			continue;
+
+		checkCachedLoads(filename, files.getFiles()[1]);
+		checkFailingResource(filename, files.getFiles()[2]);
+		if (compression != Compression::NONE)
+			checkUncachedLoads(filename, files.getFiles()[3]);
+	}
+
+	return Test::finish();
+}
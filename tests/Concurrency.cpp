@@ -0,0 +1,131 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace ZAP;
+
+namespace
+{
+	const std::size_t THREAD_COUNT = 8;
+
+	// Every thread reads every file, in a different order
+	void checkConcurrentReads(const Archive &archive, const Test::Files &files)
+	{
+		const std::vector<Test::Files::File> &all = files.getFiles();
+		std::atomic<std::size_t> failures(0);
+
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < THREAD_COUNT; ++t)
+		{
+			threads.emplace_back([&archive, &all, &failures, t]()
+			{
+				for (std::size_t n = 0; n < all.size() * 4; ++n)
+				{
+					const Test::Files::File &file = all[(n * (t + 1)) % all.size()];
+					if (!Test::hasData(archive, archive.getEntry(file.virtual_path), file.data))
+						++failures;
+				}
+			});
+		}
+		for (std::thread &thread : threads)
+			thread.join();
+
+		ZAP_CHECK(failures == 0);
+	}
+
+	// Splits a fixed number of reads of the same archive over more and more threads.
+	// Reads share nothing but the file, so the throughput should grow with the number of cores.
+	void measureThroughput(const Archive &archive, const Test::Files &files, const char *name)
+	{
+		const std::vector<Test::Files::File> &all = files.getFiles();
+		const std::size_t READS = 4096;
+
+		std::uint64_t bytes = 0;
+		for (std::size_t n = 0; n < READS; ++n)
+			bytes += all[n % all.size()].data.size();
+
+		const std::size_t threadCounts[] = { 1, 2, 4, 8 };
+		for (std::size_t threadCount : threadCounts)
+		{
+			std::atomic<std::size_t> failures(0);
+			auto start = std::chrono::steady_clock::now();
+
+			std::vector<std::thread> threads;
+			for (std::size_t t = 0; t < threadCount; ++t)
+			{
+				threads.emplace_back([&archive, &all, &failures, t, threadCount, READS]()
+				{
+					std::vector<char> buffer;
+					for (std::size_t n = t; n < READS; n += threadCount)
+					{
+						const Test::Files::File &file = all[n % all.size()];
+						buffer.resize(file.data.size());
+						std::size_t size;
+						if (!archive.getData(file.virtual_path, buffer.data(), buffer.size(), size))
+							++failures;
+					}
+				});
+			}
+			for (std::thread &thread : threads)
+				thread.join();
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			ZAP_CHECK(failures == 0);
+			std::printf("%s, %zu thread(s): %.1f MiB/s\n", name, threadCount, bytes / seconds / (1024 * 1024));
+		}
+	}
+}
+
+int main()
+{
+	Test::Files files("Concurrency");
+	for (unsigned i = 0; i < 40; ++i)
+		files.add("concurrency/" + std::to_string(i), Test::makeData(100 + i * 1531, i, (i % 4) != 0));
+
+	Test::Files throughput("Throughput");
+	for (unsigned i = 0; i < 64; ++i)
+		throughput.add("throughput/" + std::to_string(i), Test::makeData(64 * 1024, i, true));
+
+	std::printf("%u hardware thread(s)\n", std::thread::hardware_concurrency());
+
+	const Compression compressions[] = { Compression::NONE, Compression::LZ4 };
+	for (Compression compression : compressions)
+	{
+		if (!supportsCompression(compression))
+			continue;
+
+		Archive archive;
+		if (ZAP_CHECK(files.openFile(archive, compression, Version::CURRENT)))
+			checkConcurrentReads(archive, files);
+
+		Archive large;
+		if (ZAP_CHECK(throughput.openFile(large, compression, Version::CURRENT)))
+			measureThroughput(large, throughput, compression == Compression::NONE ? "Uncompressed" : "LZ4");
+	}
+
+	return Test::finish();
+}
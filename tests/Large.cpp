@@ -0,0 +1,77 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ZAP;
+
+// Entries with more compressed data than is staged in memory are decompressed a piece at a time
+int main()
+{
+	if (!supportsCompression(Compression::LZ4))
+		return Test::finish();
+
+	Test::Files files("Large");
+	files.add("before", Test::makeData(5000, 1, true));
+	// Random data barely compresses, so this is over the 64 MiB staging limit compressed too
+	files.add("large", Test::makeData(65 * 1024 * 1024, 2, false));
+	files.add("after", Test::makeData(5000, 3, false));
+
+	Archive archive;
+	if (!ZAP_CHECK(files.openFile(archive, Compression::LZ4, Version::CURRENT)))
+		return Test::finish();
+
+	const std::string &large = files.getFiles()[1].data;
+	const Archive::Entry *entry = archive.getEntry("large");
+	if (!ZAP_CHECK(entry != nullptr && entry->compressed_size > 64 * 1024 * 1024))
+		return Test::finish();
+
+	ZAP_CHECK(Test::hasData(archive, entry, large));
+
+	// The bounded read of a prefix ends within the length of the run of literals, so it falls back
+	const std::size_t prefixes[] = { 7, 100000 };
+	for (std::size_t prefix : prefixes)
+	{
+		std::vector<char> buffer(prefix);
+		std::size_t size = 0;
+		ZAP_CHECK(archive.getDataPrefix(entry, prefix, buffer.data(), buffer.size(), size) && size == prefix &&
+			std::memcmp(buffer.data(), large.data(), prefix) == 0);
+	}
+
+	Archive::EntryList entries;
+	archive.getFileList(entries);
+	std::vector<Buffer> data;
+	ZAP_CHECK(archive.getData(entries, data));
+	for (std::size_t i = 0; i < entries.size() && i < data.size(); ++i)
+	{
+		auto file = std::find_if(files.getFiles().begin(), files.getFiles().end(), [&](const Test::Files::File &file)
+		{
+			return (file.virtual_path == entries[i]->virtual_path);
+		});
+		ZAP_CHECK(file != files.getFiles().end() && data[i].getSize() == file->data.size() &&
+			std::memcmp(data[i].getData(), file->data.data(), file->data.size()) == 0);
+	}
+
+	return Test::finish();
+}
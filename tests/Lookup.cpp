@@ -0,0 +1,134 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <ZAP/PathHash.h>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+using namespace ZAP;
+
+namespace
+{
+	void checkLookups(const Archive &archive, const std::vector<std::string> &paths)
+	{
+		const std::set<std::string> present(paths.begin(), paths.end());
+		ZAP_CHECK(archive.getFileCount() == paths.size());
+
+		for (const std::string &path : paths)
+		{
+			const Archive::Entry *entry = archive.getEntry(path);
+			if (!ZAP_CHECK(entry != nullptr))
+				continue;
+
+			ZAP_CHECK(entry->virtual_path == path);
+			ZAP_CHECK(archive.getEntryByHash(hashPath(path)) == entry);
+			ZAP_CHECK(archive.hasFile(path));
+
+			// Pointer and length lookups don't need a terminator
+			const std::string padded = path + "/suffix";
+			ZAP_CHECK(archive.getEntry(padded.data(), path.size()) == entry);
+		}
+
+		// Misses that share a prefix, a suffix or a length with paths in the archive
+		std::vector<std::string> misses = { "", "/", "missing", "MISSING/0" };
+		for (std::size_t i = 0; i < paths.size(); i += 7)
+		{
+			misses.push_back(paths[i] + "x");
+			misses.push_back(paths[i].substr(0, paths[i].size() - 1));
+			misses.push_back("x" + paths[i].substr(1));
+		}
+		for (const std::string &miss : misses)
+		{
+			if (present.count(miss) != 0)
+				continue;
+
+			ZAP_CHECK(archive.getEntry(miss) == nullptr);
+			ZAP_CHECK(archive.getEntry(miss.data(), miss.size()) == nullptr);
+			ZAP_CHECK(archive.getEntryByHash(hashPath(miss)) == nullptr);
+			ZAP_CHECK(!archive.hasFile(miss));
+		}
+	}
+
+	void checkArchive(const std::string &name, std::size_t count)
+	{
+		Test::Files files(name);
+		std::vector<std::string> paths;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			paths.push_back("assets/" + std::to_string(i % 13) + "/file" + std::to_string(i) + ".dat");
+			files.add(paths.back(), std::to_string(i));
+		}
+
+		const Version versions[] = { Version::V1_0, Version::V2_0, Version::V3_0 };
+		for (Version version : versions)
+		{
+			// Version 1.0 has no room for a perfect hash and ignores the setting
+			for (int perfectHash = 0; perfectHash < 2; ++perfectHash)
+			{
+				files.setPerfectHash(perfectHash != 0);
+				std::vector<char> data;
+				if (!ZAP_CHECK(files.buildMemory(data, Compression::NONE, version)))
+					continue;
+
+				// The table flags follow the header, the entry count and the path pool size
+				if (version != Version::V1_0)
+					ZAP_CHECK(((data[12] & 4) != 0) == (perfectHash != 0 && count > 0));
+
+				// Without a perfect hash the entries are in path order, and they are padded so the hashes are aligned
+				if (version == Version::V2_0 && perfectHash == 0 && count > 0)
+				{
+					const std::size_t hashesPos = 16 + (count * 20 + 7) / 8 * 8;
+					std::uint64_t hash = 0;
+					if (ZAP_CHECK(hashesPos + sizeof(hash) <= data.size()))
+						std::memcpy(&hash, data.data() + hashesPos, sizeof(hash));
+					ZAP_CHECK(hashesPos % 8 == 0 && hash == hashPath(*std::min_element(paths.begin(), paths.end())));
+				}
+
+				const Archive::IndexMode modes[] = { Archive::IndexMode::IMMEDIATE, Archive::IndexMode::LAZY, Archive::IndexMode::BACKGROUND };
+				for (Archive::IndexMode mode : modes)
+				{
+					Archive archive;
+					archive.setIndexMode(mode);
+					ZAP_CHECK(archive.openBorrowedMemory(data.data(), data.size()));
+					checkLookups(archive, paths);
+				}
+
+				Archive file;
+				ZAP_CHECK(files.openFile(file, Compression::NONE, version));
+				checkLookups(file, paths);
+			}
+		}
+	}
+}
+
+int main()
+{
+	checkArchive("LookupEmpty", 0);
+	checkArchive("LookupOne", 1);
+	checkArchive("LookupFew", 7);
+	checkArchive("LookupMany", 3000);
+
+	return Test::finish();
+}
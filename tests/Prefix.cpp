@@ -0,0 +1,74 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ZAP;
+
+namespace
+{
+	void checkPrefixes(const Archive &archive, const Test::Files &files)
+	{
+		const std::size_t sizes[] = { 1, 7, 15, 16, 255, 300, 4096, 65536, 69999, 70000, 1000000 };
+		for (const Test::Files::File &file : files.getFiles())
+		{
+			const Archive::Entry *entry = archive.getEntry(file.virtual_path);
+			for (std::size_t prefix : sizes)
+			{
+				const std::size_t expected = std::min(prefix, file.data.size());
+				std::vector<char> buffer(expected);
+				std::size_t size = 0;
+				ZAP_CHECK(archive.getDataPrefix(entry, prefix, buffer.data(), buffer.size(), size) && size == expected &&
+					std::memcmp(buffer.data(), file.data.data(), expected) == 0);
+			}
+		}
+	}
+}
+
+int main()
+{
+	Test::Files files("Prefix");
+	// Incompressible data is one long run of literals, its length field alone is longer than a small prefix
+	files.add("random", Test::makeData(70000, 1, false));
+	files.add("words", Test::makeData(70000, 2, true));
+	files.add("mixed", Test::makeData(3000, 3, false) + Test::makeData(100000, 4, true));
+
+	const Compression compressions[] = { Compression::NONE, Compression::LZ4 };
+	for (Compression compression : compressions)
+	{
+		if (!supportsCompression(compression))
+			continue;
+
+		const std::string filename = files.buildFile(compression, Version::CURRENT);
+		Archive archive;
+		if (ZAP_CHECK(!filename.empty() && archive.openFile(filename)))
+			checkPrefixes(archive, files);
+
+		Archive mapped;
+		if (ZAP_CHECK(mapped.openMappedFile(filename)))
+			checkPrefixes(mapped, files);
+	}
+
+	return Test::finish();
+}
@@ -0,0 +1,148 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include "Config.h"
+#include "File.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace ZAP;
+
+namespace
+{
+	// Every request is completed once and read right, whatever the depth, including depths
+	// the ring is too small for and one past the end of the file
+	void checkBatch(const File &file, const std::string &data, unsigned depth)
+	{
+		const std::size_t count = 1000;
+		std::vector<std::vector<char>> buffers(count);
+		std::vector<File::ReadRequest> requests(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::size_t size = 1 + (i * 7919) % 65536;
+			std::uint64_t offset = (i * 104729) % (data.size() - size);
+			if (i == count / 2)
+				offset = data.size() - 10;
+
+			buffers[i].resize(size);
+			File::ReadRequest request = { offset, buffers[i].data(), size, false };
+			requests[i] = request;
+		}
+
+		std::vector<std::size_t> completions(count, 0);
+		file.read(requests.data(), requests.size(), depth, [&](File::ReadRequest &request)
+		{
+			++completions[&request - requests.data()];
+		});
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const File::ReadRequest &request = requests[i];
+			ZAP_CHECK(completions[i] == 1);
+			if (i == count / 2 && request.size > 10)
+				ZAP_CHECK(!request.success);
+			else
+				ZAP_CHECK(request.success && std::memcmp(request.data, data.data() + request.offset, request.size) == 0);
+		}
+	}
+
+	// Reads every other entry of an archive as one batch, with the page cache dropped first and with it warm.
+	// Depth 0 is the positional reads every build has, the other depths only differ with io_uring.
+	void measureDepths(const std::string &filename, const Test::Files &files)
+	{
+		Archive archive;
+		if (!ZAP_CHECK(archive.openFile(filename)))
+			return;
+
+		Archive::EntryList entries;
+		std::uint64_t bytes = 0;
+		for (std::size_t i = 0; i < files.getFiles().size(); i += 2)
+		{
+			entries.push_back(archive.getEntry(files.getFiles()[i].virtual_path));
+			bytes += files.getFiles()[i].data.size();
+		}
+
+		const unsigned depths[] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+		for (unsigned depth : depths)
+		{
+			archive.setQueueDepth(depth);
+
+			double rates[2];
+			for (int warm = 0; warm < 2; ++warm)
+			{
+				if (!warm)
+					archive.release(entries, 0);
+
+				std::vector<Buffer> data;
+				auto start = std::chrono::steady_clock::now();
+				ZAP_CHECK(archive.getData(entries, data, 0));
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				rates[warm] = bytes / seconds / (1024 * 1024);
+			}
+
+			if (depth == 0)
+				std::printf("Positional reads: %.1f MiB/s cold, %.1f MiB/s warm\n", rates[0], rates[1]);
+			else
+				std::printf("Depth %u: %.1f MiB/s cold, %.1f MiB/s warm\n", depth, rates[0], rates[1]);
+		}
+	}
+}
+
+int main()
+{
+#ifdef ZAP_IO_URING
+	std::printf("Batches are read with io_uring\n");
+#else
+	std::printf("Batches are read with positional reads, the depth makes no difference\n");
+#endif
+
+	const std::string filename = "QueueDepth.bin";
+	const std::string data = Test::makeData(4 * 1024 * 1024, 1, false);
+	{
+		std::ofstream stream(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		stream.write(data.data(), data.size());
+	}
+
+	File file;
+	if (ZAP_CHECK(file.open(filename)))
+	{
+		const unsigned depths[] = { 0, 1, 7, Archive::DEFAULT_QUEUE_DEPTH, File::MAX_QUEUE_DEPTH + 1 };
+		for (unsigned depth : depths)
+			checkBatch(file, data, depth);
+		file.close();
+	}
+	std::remove(filename.c_str());
+
+	Test::Files files("QueueDepth");
+	for (unsigned i = 0; i < 256; ++i)
+		files.add("depth/" + std::to_string(i), Test::makeData(256 * 1024, i, false));
+
+	const std::string archive = files.buildFile(Compression::NONE, Version::CURRENT);
+	if (ZAP_CHECK(!archive.empty()))
+		measureDepths(archive, files);
+
+	return Test::finish();
+}
@@ -0,0 +1,129 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <ZAP/EntryStream.h>
+
+#include <atomic>
+
+using namespace ZAP;
+
+namespace
+{
+	// Counts the allocations and the bytes that haven't been freed yet
+	class CountingResource : public MemoryResource
+	{
+	public:
+		CountingResource() : allocations(0), allocated(0) {}
+
+		std::size_t getAllocations() const
+		{
+			return allocations;
+		}
+		std::size_t getAllocated() const
+		{
+			return allocated;
+		}
+
+	protected:
+		void *doAllocate(std::size_t bytes, std::size_t alignment) override
+		{
+			++allocations;
+			allocated += bytes;
+			return getDefaultResource()->allocate(bytes, alignment);
+		}
+		void doDeallocate(void *data, std::size_t bytes, std::size_t alignment) override
+		{
+			allocated -= bytes;
+			getDefaultResource()->deallocate(data, bytes, alignment);
+		}
+
+	private:
+		std::atomic<std::size_t> allocations;
+		std::atomic<std::size_t> allocated;
+	};
+
+	// Compressed data is staged in memory of the archive's resource, which is freed when the load finishes
+	void checkStaging(const std::string &filename, const Test::Files &files)
+	{
+		CountingResource resource;
+		Archive archive;
+		archive.setMemoryResource(&resource);
+		if (!ZAP_CHECK(archive.openFile(filename)))
+			return;
+
+		const std::size_t allocated = resource.getAllocated();
+		for (const Test::Files::File &file : files.getFiles())
+		{
+			const Archive::Entry *entry = archive.getEntry(file.virtual_path);
+			const std::size_t allocations = resource.getAllocations();
+			{
+				Buffer buffer;
+				ZAP_CHECK(archive.getData(entry, buffer) && buffer.getSize() == file.data.size());
+			}
+			ZAP_CHECK(resource.getAllocations() == allocations + 2 && resource.getAllocated() == allocated);
+
+			char prefix[100];
+			std::size_t size = 0;
+			ZAP_CHECK(archive.getDataPrefix(entry, sizeof(prefix), prefix, sizeof(prefix), size) && size == sizeof(prefix));
+			ZAP_CHECK(resource.getAllocations() > allocations + 2 && resource.getAllocated() == allocated);
+		}
+	}
+
+	// Readers take their buffers from the archive's resource and free them when closed
+	void checkReader(const std::string &filename, const Test::Files &files)
+	{
+		CountingResource resource;
+		Archive archive;
+		archive.setMemoryResource(&resource);
+		if (!ZAP_CHECK(archive.openFile(filename)))
+			return;
+
+		const std::size_t allocated = resource.getAllocated();
+		EntryReader reader(archive, archive.getEntry(files.getFiles()[0].virtual_path));
+		ZAP_CHECK(resource.getAllocated() == allocated + EntryReader::INPUT_SIZE + EntryReader::WINDOW_SIZE);
+
+		char data[1000];
+		ZAP_CHECK(reader.read(data, sizeof(data)) == sizeof(data) && !reader.hasFailed());
+		reader.close();
+		ZAP_CHECK(resource.getAllocated() == allocated);
+	}
+}
+
+int main()
+{
+	Test::Files files("Resource");
+	files.add("words", Test::makeData(200000, 1, true));
+	files.add("random", Test::makeData(5000, 2, false));
+
+	if (supportsCompression(Compression::LZ4))
+	{
+		const std::string filename = files.buildFile(Compression::LZ4, Version::CURRENT);
+		if (ZAP_CHECK(!filename.empty()))
+		{
+			checkStaging(filename, files);
+			checkReader(filename, files);
+		}
+	}
+
+	return Test::finish();
+}
@@ -0,0 +1,156 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <ZAP/EntryStream.h>
+#include <ZAP/PathHash.h>
+
+#include <cstring>
+
+using namespace ZAP;
+
+namespace
+{
+	// Checks that every file comes back out of an opened archive, with every way of reading it
+	void checkArchive(const Archive &archive, const Test::Files &files, Version version, Compression compression)
+	{
+		ZAP_CHECK(archive.isOpen());
+		ZAP_CHECK(archive.getVersion() == version);
+		ZAP_CHECK(archive.getCompression() == compression);
+		ZAP_CHECK(archive.getFileCount() == files.getFiles().size());
+
+		for (const Test::Files::File &file : files.getFiles())
+		{
+			const Archive::Entry *entry = archive.getEntry(file.virtual_path);
+			if (!ZAP_CHECK(entry != nullptr))
+				continue;
+
+			ZAP_CHECK(entry->virtual_path == file.virtual_path);
+			ZAP_CHECK(entry->decompressed_size == file.data.size());
+			ZAP_CHECK(entry->hash == hashPath(file.virtual_path));
+			if (compression == Compression::NONE)
+				ZAP_CHECK(entry->compressed_size == file.data.size());
+
+			if (file.data.empty())
+				continue;
+
+			ZAP_CHECK(Test::hasData(archive, entry, file.data));
+
+			Buffer buffer;
+			ZAP_CHECK(archive.getData(file.virtual_path, buffer) && buffer.getSize() == file.data.size() &&
+				std::memcmp(buffer.getData(), file.data.data(), file.data.size()) == 0);
+
+			Archive::View view;
+			ZAP_CHECK(archive.getView(entry, view) && view.size == file.data.size() &&
+				std::memcmp(view.data.get(), file.data.data(), file.data.size()) == 0);
+
+			std::string streamed;
+			EntryReader reader(archive, entry);
+			const char *chunk;
+			for (std::size_t count; (count = reader.readChunk(chunk)) > 0;)
+				streamed.append(chunk, count);
+			ZAP_CHECK(reader.isEnd() && !reader.hasFailed() && streamed == file.data);
+		}
+
+		ZAP_CHECK(archive.getEntry("missing") == nullptr);
+	}
+
+	void checkVersion(Test::Files &files, Version version, Compression compression)
+	{
+		const std::string filename = files.buildFile(compression, version);
+		if (!ZAP_CHECK(!filename.empty()))
+			return;
+
+		Archive file;
+		ZAP_CHECK(file.openFile(filename));
+		checkArchive(file, files, version, compression);
+
+		Archive mapped;
+		ZAP_CHECK(mapped.openMappedFile(filename));
+		checkArchive(mapped, files, version, compression);
+
+		std::vector<char> data;
+		if (!ZAP_CHECK(files.buildMemory(data, compression, version)))
+			return;
+
+		Archive memory;
+		ZAP_CHECK(memory.openMemory(data.data(), data.size()));
+		checkArchive(memory, files, version, compression);
+
+		Archive borrowed;
+		ZAP_CHECK(borrowed.openBorrowedMemory(data.data(), data.size()));
+		checkArchive(borrowed, files, version, compression);
+	}
+}
+
+int main()
+{
+	Test::Files files("RoundTrip");
+	files.add("empty", std::string());
+	files.add("a", "a");
+	files.add("text/words.txt", Test::makeData(100000, 1, true));
+	files.add("binary/random.bin", Test::makeData(70000, 2, false));
+	files.add("binary/large.bin", Test::makeData(300000, 3, true));
+	for (unsigned i = 0; i < 50; ++i)
+		files.add("small/" + std::to_string(i), Test::makeData(i * 37, 10 + i, (i % 2) == 0));
+
+	const Version versions[] = { Version::V1_0, Version::V2_0, Version::V3_0 };
+	const Compression compressions[] = { Compression::NONE, Compression::LZ4 };
+	for (Version version : versions)
+	{
+		for (Compression compression : compressions)
+		{
+			if (supportsCompression(compression))
+				checkVersion(files, version, compression);
+		}
+	}
+
+	// Streamed archives have their table in a footer, which version 1.0 has no room for
+	for (Version version : versions)
+	{
+		for (Compression compression : compressions)
+		{
+			std::vector<char> data;
+			if (!supportsCompression(compression))
+				continue;
+			if (version == Version::V1_0)
+			{
+				ZAP_CHECK(!files.buildStream(data, compression, version));
+				continue;
+			}
+			if (!ZAP_CHECK(files.buildStream(data, compression, version)))
+				continue;
+
+			Archive streamed;
+			ZAP_CHECK(streamed.openMemory(data.data(), data.size()));
+			checkArchive(streamed, files, version, compression);
+		}
+	}
+
+	// Version 3.0 is only written when asked for
+	std::vector<char> data;
+	Archive current;
+	ZAP_CHECK(files.buildMemory(data, Compression::NONE, Version::CURRENT) && current.openMemory(data.data(), data.size()) &&
+		current.getVersion() == Version::V2_0);
+
+	return Test::finish();
+}
@@ -0,0 +1,168 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#include "Test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	int failures = 0;
+
+	// xorshift32, so the data is the same with every standard library
+	std::uint32_t nextRandom(std::uint32_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+namespace ZAP
+{
+	namespace Test
+	{
+		bool check(bool condition, const char *text, const char *file, int line)
+		{
+			if (!condition)
+			{
+				std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+				++failures;
+			}
+			return condition;
+		}
+
+		int finish()
+		{
+			if (failures > 0)
+			{
+				std::fprintf(stderr, "%d check(s) failed\n", failures);
+				return 1;
+			}
+			return 0;
+		}
+
+		std::string makeData(std::size_t size, unsigned seed, bool compressible)
+		{
+			static const char *const words[] = { "asset ", "texture ", "mesh ", "sound ", "level ", "shader ", "\n" };
+			std::uint32_t state = seed * 2654435761u + 1;
+			std::string data;
+			data.reserve(size);
+			while (data.size() < size)
+			{
+				if (compressible)
+					data += words[nextRandom(state) % (sizeof(words) / sizeof(words[0]))];
+				else
+					data += static_cast<char>(nextRandom(state) >> 24);
+			}
+			data.resize(size);
+			return data;
+		}
+
+		bool hasData(const Archive &archive, const Archive::Entry *entry, const std::string &data)
+		{
+			if (entry == nullptr || entry->decompressed_size != data.size())
+				return false;
+
+			std::vector<char> buffer(data.size());
+			std::size_t size = 0;
+			return (archive.getData(entry, buffer.data(), buffer.size(), size) && size == data.size() &&
+				std::memcmp(buffer.data(), data.data(), size) == 0);
+		}
+
+		Files::Files(const std::string &name) : name(name)
+		{
+		}
+		Files::~Files()
+		{
+			for (const std::string &filename : written)
+				std::remove(filename.c_str());
+		}
+
+		void Files::add(const std::string &virtual_path, const std::string &data)
+		{
+			std::string filename = name + "." + std::to_string(files.size()) + ".bin";
+			std::ofstream stream(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			stream.write(data.data(), data.size());
+			stream.close();
+			written.push_back(filename);
+
+			File file = { virtual_path, data };
+			files.push_back(file);
+			builder.addFile(filename, virtual_path);
+		}
+
+		void Files::setPerfectHash(bool enabled)
+		{
+			builder.setPerfectHash(enabled);
+		}
+
+		std::string Files::buildFile(Compression compression, Version version)
+		{
+			std::string filename = name + ".zap";
+			if (!builder.buildFile(filename, compression, version))
+				return std::string();
+
+			if (std::find(written.begin(), written.end(), filename) == written.end())
+				written.push_back(filename);
+			return filename;
+		}
+
+		bool Files::openFile(Archive &archive, Compression compression, Version version)
+		{
+			const std::string filename = buildFile(compression, version);
+			return (!filename.empty() && archive.openFile(filename));
+		}
+
+		bool Files::buildMemory(std::vector<char> &data, Compression compression, Version version)
+		{
+			char *built;
+			std::size_t size;
+			if (!builder.buildMemory(built, size, compression, version))
+				return false;
+
+			data.assign(built, built + size);
+			delete[] built;
+			return true;
+		}
+
+		bool Files::buildStream(std::vector<char> &data, Compression compression, Version version)
+		{
+			std::ostringstream stream(std::ios::out | std::ios::binary);
+			if (!builder.buildStream(stream, compression, version))
+				return false;
+
+			const std::string built = stream.str();
+			data.assign(built.begin(), built.end());
+			return true;
+		}
+
+		const std::vector<Files::File> &Files::getFiles() const
+		{
+			return files;
+		}
+	}
+}
@@ -0,0 +1,103 @@
+/*The MIT License (MIT)
+
+Copyright (c) 2021 Johannes Häggqvist
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.*/
+#ifndef ZAP_Test_h__
+#define ZAP_Test_h__
+
+#include <ZAP/Archive.h>
+#include <ZAP/ArchiveBuilder.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Counts a failure and reports it, without stopping the test
+#define ZAP_CHECK(condition) ZAP::Test::check((condition), #condition, __FILE__, __LINE__)
+
+namespace ZAP
+{
+	namespace Test
+	{
+		///\brief Reports a failed condition, returns the condition.
+		bool check(bool condition, const char *text, const char *file, int line);
+
+		///\brief Returns the exit code of a test, non-zero if a check failed.
+		int finish();
+
+		///\brief Returns size bytes of data, the same for the same seed.
+		///\param size Number of bytes.
+		///\param seed Seed of the data.
+		///\param compressible Whether to repeat short runs so LZ4 finds matches, or to use random bytes.
+		std::string makeData(std::size_t size, unsigned seed, bool compressible);
+
+		///\brief Returns whether an entry holds the given data.
+		bool hasData(const Archive &archive, const Archive::Entry *entry, const std::string &data);
+
+		///\brief Files added to an archive, written next to the test so ArchiveBuilder can read them.
+		class Files
+		{
+		public:
+			struct File
+			{
+				std::string virtual_path;
+				std::string data;
+			};
+
+			///\param name Prefix of the files written for this set, unique per test.
+			explicit Files(const std::string &name);
+
+			///\brief Removes the written files.
+			~Files();
+
+			///\brief Writes a file and adds it.
+			void add(const std::string &virtual_path, const std::string &data);
+
+			///\brief Sets whether the archives get a perfect hash, see ArchiveBuilder::setPerfectHash().
+			void setPerfectHash(bool enabled);
+
+			///\brief Builds an archive of all added files to name.zap.
+			///\return The filename, empty if the build failed.
+			std::string buildFile(Compression compression, Version version);
+
+			///\brief Builds an archive of all added files to name.zap and opens it with Archive::openFile().
+			bool openFile(Archive &archive, Compression compression, Version version);
+
+			///\brief Builds an archive of all added files to memory.
+			bool buildMemory(std::vector<char> &data, Compression compression, Version version);
+
+			///\brief Builds an archive of all added files with ArchiveBuilder::buildStream().
+			bool buildStream(std::vector<char> &data, Compression compression, Version version);
+
+			const std::vector<File> &getFiles() const;
+
+		private:
+			Files(const Files&) = delete;
+			Files &operator=(const Files&) = delete;
+
+			std::string name;
+			std::vector<File> files;
+			std::vector<std::string> written;
+			ArchiveBuilder builder;
+		};
+	}
+}
+
+#endif // ZAP_Test_h__